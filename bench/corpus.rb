@@ -0,0 +1,100 @@
+#!/usr/bin/env ruby
+# Fetch the benchmark corpus into bench/corpus (not checked in) and list its
+# files in bench/corpus/files.txt, for `mrc-bench -l bench/corpus/files.txt`.
+#
+#   ruby bench/corpus.rb
+#
+# bench/corpus.lock pins every source to a release tag and, once known, to
+# the commit that tag named. A fetch that gets a different commit stops, so
+# every run compiles the same files. A source without a commit yet is
+# fetched at its tag and the commit is written back; commit the lock file
+# after that.
+
+require 'fileutils'
+require_relative 'generate'
+
+BENCH_DIR = __dir__
+CORPUS_DIR = File.join(BENCH_DIR, 'corpus')
+LOCK_FILE = File.join(BENCH_DIR, 'corpus.lock')
+LIST_FILE = File.join(CORPUS_DIR, 'files.txt')
+
+# the tags and commits are in corpus.lock
+SOURCES = [
+  { name: 'mruby', url: 'https://github.com/mruby/mruby.git',
+    globs: %w(mrblib/**/*.rb mrbgems/*/mrblib/**/*.rb) },
+  { name: 'picoruby', url: 'https://github.com/picoruby/picoruby.git',
+    globs: %w(mrbgems/*/mrblib/**/*.rb) },
+]
+
+# name => [generator, size]; see generate.rb
+GENERATED = {
+  'statements_20000.rb' => [:statements, 20_000],
+  'literals_20000.rb' => [:literals, 20_000],
+  'case_5000.rb' => [:case_arms, 5_000],
+  'classes_2000.rb' => [:classes, 2_000],
+}
+
+# name => [tag, commit or nil]
+def read_lock
+  File.readlines(LOCK_FILE, chomp: true).each_with_object({}) do |line, lock|
+    next if line.empty? || line.start_with?('#')
+    name, tag, commit = line.split
+    lock[name] = [tag, commit == '-' ? nil : commit]
+  end
+end
+
+def write_lock(lock, header)
+  File.open(LOCK_FILE, 'w') do |f|
+    header.each { |line| f.puts line }
+    lock.each { |name, (tag, commit)| f.puts "#{name} #{tag} #{commit || '-'}" }
+  end
+end
+
+def git(dir, *args)
+  system('git', '-C', dir, *args, exception: true)
+end
+
+# shallow fetch of one commit or tag; returns the commit checked out
+def fetch(source, want)
+  dir = File.join(CORPUS_DIR, source[:name])
+  unless File.directory?(File.join(dir, '.git'))
+    FileUtils.mkdir_p(dir)
+    git(dir, 'init', '--quiet')
+    git(dir, 'remote', 'add', 'origin', source[:url])
+  end
+  git(dir, 'fetch', '--quiet', '--depth', '1', 'origin', want)
+  git(dir, 'checkout', '--quiet', '--detach', 'FETCH_HEAD')
+  IO.popen(['git', '-C', dir, 'rev-parse', 'HEAD'], &:read).strip
+end
+
+lock = read_lock
+header = File.readlines(LOCK_FILE, chomp: true).take_while { |line| line.start_with?('#') }
+files = []
+
+SOURCES.each do |source|
+  abort "corpus.rb: #{source[:name]} is not in #{LOCK_FILE}" unless lock[source[:name]]
+  tag, commit = lock[source[:name]]
+  got = fetch(source, commit || "refs/tags/#{tag}")
+  if commit && got != commit
+    abort "corpus.rb: #{source[:name]} fetched #{got}, but corpus.lock pins #{commit}"
+  end
+  lock[source[:name]] = [tag, got]
+  dir = File.join(CORPUS_DIR, source[:name])
+  source[:globs].each do |glob|
+    files.concat(Dir.glob(File.join(dir, glob)).sort)
+  end
+end
+write_lock(lock, header)
+
+gen_dir = File.join(CORPUS_DIR, 'generated')
+FileUtils.mkdir_p(gen_dir)
+GENERATED.each do |name, (generator, size)|
+  path = File.join(gen_dir, name)
+  File.write(path, Generate.public_send(generator, size))
+  files << path
+end
+
+# relative to the gem directory, where mrc-bench is meant to be run
+root = File.dirname(BENCH_DIR)
+File.write(LIST_FILE, files.map { |f| f.delete_prefix("#{root}/") }.join("\n") + "\n")
+puts "#{files.size} files listed in #{LIST_FILE}"
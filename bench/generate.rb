@@ -0,0 +1,106 @@
+# Deterministic Ruby sources for the compiler benchmarks: the large
+# generated files of the corpus (corpus.rb) and the inputs of the scaling
+# runs (scaling.rb). The same arguments always give the same bytes.
+
+module Generate
+  LOCALS = 16
+
+  module_function
+
+  # one method of `n` statements over a handful of locals
+  def statements(n)
+    src = +"def bench_statements\n"
+    LOCALS.times { |i| src << "  a#{i} = #{i}\n" }
+    n.times do |i|
+      src << "  a#{i % LOCALS} = a#{(i + 1) % LOCALS} + #{i}\n"
+    end
+    src << "  a0\nend\n"
+  end
+
+  # an array of `n` distinct integer, float and string literals
+  def literals(n)
+    src = +"BENCH_LITERALS = [\n"
+    n.times do |i|
+      src << case i % 3
+             when 0 then "  #{i * 100_003},\n"
+             when 1 then "  #{i}.5,\n"
+             else        "  \"str#{i}\",\n"
+             end
+    end
+    src << "]\n"
+  end
+
+  # `n` case arms
+  def case_arms(n)
+    src = +"def bench_case(v)\n  case v\n"
+    n.times { |i| src << "  when #{i} then :arm#{i}\n" }
+    src << "  else nil\n  end\nend\n"
+  end
+
+  # `n` distinct method names and symbol literals
+  def symbols(n)
+    src = +"def bench_symbols(o)\n"
+    n.times { |i| src << "  o.meth#{i}(:sym#{i})\n" }
+    src << "end\n"
+  end
+
+  # blocks nested `n` deep; the codegen stops at MRC_CODEGEN_LEVEL_MAX.
+  # Not indented, so that the size stays linear in `n`.
+  def nested_blocks(n)
+    src = +"def bench_blocks(o)\n"
+    n.times { |i| src << "o.each do |b#{i}|\n" }
+    src << "b0\n"
+    n.times { src << "end\n" }
+    src << "end\n"
+  end
+
+  # a file of `n` lines of top-level code, comments and blank lines
+  def lines(n)
+    src = +"x = 0\n"
+    (n - 1).times do |i|
+      src << case i % 3
+             when 0 then "x = x + #{i}\n"
+             when 1 then "# line #{i}\n"
+             else        "\n"
+             end
+    end
+    src
+  end
+
+  # `n` duplicated hash keys, each a parser warning
+  def warnings(n)
+    src = +""
+    n.times { |i| src << "h#{i} = { k: #{i}, k: #{i + 1} }\n" }
+    src
+  end
+
+  # `n` small classes, the shape of a typical mrblib file
+  def classes(n)
+    src = +""
+    n.times do |i|
+      src << <<~RUBY
+        class BenchClass#{i}
+          attr_reader :value
+
+          def initialize(value)
+            @value = value
+          end
+
+          def step(n = 1)
+            if n > 0
+              @value += n
+            else
+              @value -= 1
+            end
+            self
+          end
+
+          def to_s
+            "BenchClass#{i}(\#{@value})"
+          end
+        end
+      RUBY
+    end
+    src
+  end
+end
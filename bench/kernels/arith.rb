@@ -0,0 +1,11 @@
+# integer and float arithmetic on locals, with foldable constants
+n = (ARGV[0] || 2_000_000).to_i
+i = 0
+acc = 0
+f = 0.0
+while i < n
+  acc = (acc + i * 3 - (i >> 1) + 60 * 60) & 0xffff
+  f += i * 0.5 / 2
+  i += 1
+end
+p acc, f
@@ -0,0 +1,8 @@
+# blocks that read and write an outer local
+n = (ARGV[0] || 20_000).to_i
+ary = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10] * 10
+sum = 0
+n.times do
+  ary.each { |x| sum += x }
+end
+p sum
@@ -0,0 +1,19 @@
+# case/when over integers, lists, ranges and classes
+def classify(v)
+  case v
+  when 0 then 0
+  when 1, 2, 3 then 1
+  when 4..99 then 2
+  when Integer then 3
+  else 4
+  end
+end
+
+n = (ARGV[0] || 1_000_000).to_i
+counts = [0, 0, 0, 0, 0]
+i = 0
+while i < n
+  counts[classify(i % 200)] += 1
+  i += 1
+end
+p counts
@@ -0,0 +1,9 @@
+# while loop with a compound condition
+n = (ARGV[0] || 3_000_000).to_i
+i = 0
+sum = 0
+while i < n
+  sum += i if i.odd? && i % 3 != 0
+  i += 1
+end
+p sum
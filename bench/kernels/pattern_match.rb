@@ -0,0 +1,20 @@
+# case/in with value, array and hash patterns
+def area(shape)
+  case shape
+  in [:circle, r] then 3 * r * r
+  in [:rect, w, h] then w * h
+  in {type: :square, side: s} then s * s
+  in Integer => k then k
+  else 0
+  end
+end
+
+n = (ARGV[0] || 500_000).to_i
+shapes = [[:circle, 2], [:rect, 3, 4], {type: :square, side: 5}, 7, :none]
+i = 0
+total = 0
+while i < n
+  total += area(shapes[i % shapes.size])
+  i += 1
+end
+p total
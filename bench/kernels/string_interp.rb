@@ -0,0 +1,10 @@
+# string interpolation of integers and literals
+n = (ARGV[0] || 300_000).to_i
+i = 0
+len = 0
+while i < n
+  s = "item #{i}: #{i * 2} (#{i.even? ? 'even' : 'odd'})"
+  len += s.size
+  i += 1
+end
+p len
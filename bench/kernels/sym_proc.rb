@@ -0,0 +1,11 @@
+# &:sym block arguments, through Symbol#to_proc (or a lambda in the
+# sym_proc build of run_kernels.rb)
+n = (ARGV[0] || 200_000).to_i
+words = %w(alpha beta gamma delta epsilon)
+total = 0
+i = 0
+while i < n
+  words.map(&:upcase).each { |w| total += w.size }
+  i += 1
+end
+p total
@@ -0,0 +1,90 @@
+#!/usr/bin/env ruby
+# Compile every micro-kernel in bench/kernels both optimized and with
+# --no-optimize, run each on the mruby VM, and report the best wall time
+# of each build. If mrc-bench is there, also report the static instruction
+# count, and add a third build compiled by it with --sym-proc (`&:sym` as a
+# lambda). All builds must print the same thing.
+#
+#   ruby bench/run_kernels.rb [--bin DIR] [-r RUNS] [kernel...]
+#
+# DIR holds mrbc-prism, mruby-prism and, optionally, mrc-bench
+# (default build/host/bin). Prints JSON.
+
+require 'json'
+require 'optparse'
+require 'tmpdir'
+
+KERNEL_DIR = File.join(__dir__, 'kernels')
+MODES = { 'optimized' => [], 'no_optimize' => %w(--no-optimize) }
+# built by mrc-bench, since mrbc-prism has no switch for c->sym_proc
+BENCH_MODES = { 'sym_proc' => %w(--sym-proc) }
+
+def clock
+  Process.clock_gettime(Process::CLOCK_MONOTONIC, :nanosecond)
+end
+
+def compile(bin, flags, src, out)
+  system(File.join(bin, 'mrbc-prism'), *flags, '-o', out, src) or
+    abort "run_kernels.rb: cannot compile #{src} (#{flags.join(' ')})"
+end
+
+def bench_compile(bin, flags, src, out)
+  system(File.join(bin, 'mrc-bench'), '-n', '1', *flags, '-o', out, src, out: File::NULL) or
+    abort "run_kernels.rb: cannot compile #{src} (mrc-bench #{flags.join(' ')})"
+end
+
+# best wall time of `runs` runs, and the output of the first
+def run(bin, mrb, runs)
+  output = nil
+  best = nil
+  runs.times do
+    start = clock
+    out = IO.popen([File.join(bin, 'mruby-prism'), '-b', mrb], &:read)
+    ns = clock - start
+    abort "run_kernels.rb: #{mrb} failed" unless $?.success?
+    output ||= out
+    best = ns if best.nil? || ns < best
+  end
+  [best, output]
+end
+
+def static_insns(bin, flags, src)
+  bench = File.join(bin, 'mrc-bench')
+  return nil unless File.executable?(bench)
+  JSON.parse(IO.popen([bench, '--metrics', *flags, src], &:read))['insns']
+rescue JSON::ParserError
+  nil
+end
+
+bin = 'build/host/bin'
+runs = 5
+OptionParser.new do |opt|
+  opt.on('--bin DIR', 'directory of mrbc-prism and mruby-prism') { |v| bin = v }
+  opt.on('-r RUNS', Integer, 'runs per build (best is kept)') { |v| runs = v }
+end.parse!
+kernels = ARGV.empty? ? Dir.glob(File.join(KERNEL_DIR, '*.rb')).sort.map { |f| File.basename(f, '.rb') } : ARGV
+
+report = {}
+Dir.mktmpdir('mrc-kernels') do |dir|
+  kernels.each do |name|
+    src = File.join(KERNEL_DIR, "#{name}.rb")
+    abort "run_kernels.rb: no kernel #{name}" unless File.exist?(src)
+    modes = MODES.map { |mode, flags| [mode, flags, false] }
+    modes += BENCH_MODES.map { |mode, flags| [mode, flags, true] } if File.executable?(File.join(bin, 'mrc-bench'))
+    results = modes.to_h do |mode, flags, by_bench|
+      mrb = File.join(dir, "#{name}_#{mode}.mrb")
+      by_bench ? bench_compile(bin, flags, src, mrb) : compile(bin, flags, src, mrb)
+      ns, output = run(bin, mrb, runs)
+      [mode, { 'ns' => ns, 'insns' => static_insns(bin, flags, src), 'output' => output }]
+    end
+    outputs = results.values.map { |r| r.delete('output') }.uniq
+    abort "run_kernels.rb: #{name} prints differently between builds" if outputs.size > 1
+    results['speedup'] = (results['no_optimize']['ns'].to_f / results['optimized']['ns']).round(3)
+    if results['sym_proc']
+      results['sym_proc_speedup'] = (results['optimized']['ns'].to_f / results['sym_proc']['ns']).round(3)
+    end
+    report[name] = results
+  end
+end
+
+puts JSON.pretty_generate(report)
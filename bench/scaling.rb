@@ -0,0 +1,83 @@
+#!/usr/bin/env ruby
+# Time compilation of generated inputs at doubling sizes and fit the growth
+# exponent k of time ~ size**k for every scenario, so that a quadratic path
+# (k near 2) shows up at once. Needs mrc-bench (build with MRC_BENCH=yes).
+#
+#   ruby bench/scaling.rb [--bench PATH] [-n N] [--threshold K] [scenario...]
+#
+# Prints JSON. Exits with 1 if a scenario's total exponent exceeds the
+# threshold (default 1.3).
+
+require 'json'
+require 'optparse'
+require 'tmpdir'
+require_relative 'generate'
+
+# name => [generator, smallest size, doublings]
+SCENARIOS = {
+  'statements' => [:statements, 2_000, 5],
+  'literals' => [:literals, 2_000, 5],
+  'symbols' => [:symbols, 2_000, 5],
+  'nested_blocks' => [:nested_blocks, 4, 4],   # MRC_CODEGEN_LEVEL_MAX caps the depth
+  'case_arms' => [:case_arms, 500, 5],
+  'lines' => [:lines, 10_000, 5],
+  'warnings' => [:warnings, 1_000, 5],
+}
+PHASES = %w(parse codegen dump)
+
+# least-squares slope of log(ns) over log(size)
+def exponent(sizes, ns)
+  points = sizes.zip(ns).select { |_, t| t > 0 }
+  return nil if points.size < 2
+  xs = points.map { |s, _| Math.log(s) }
+  ys = points.map { |_, t| Math.log(t) }
+  mx = xs.sum / xs.size
+  my = ys.sum / ys.size
+  den = xs.sum { |x| (x - mx)**2 }
+  return nil if den == 0
+  (xs.zip(ys).sum { |x, y| (x - mx) * (y - my) } / den).round(3)
+end
+
+def run_bench(bench, iterations, files)
+  out = IO.popen([bench, '-n', iterations.to_s, *files], &:read)
+  abort "scaling.rb: #{bench} failed" unless $?.success?
+  JSON.parse(out)['files']
+end
+
+bench = ENV['MRC_BENCH_BIN'] || 'build/host/bin/mrc-bench'
+iterations = 3
+threshold = 1.3
+OptionParser.new do |opt|
+  opt.on('--bench PATH', 'mrc-bench executable') { |v| bench = v }
+  opt.on('-n N', Integer, 'iterations per file (best is kept)') { |v| iterations = v }
+  opt.on('--threshold K', Float, 'largest acceptable exponent') { |v| threshold = v }
+end.parse!
+names = ARGV.empty? ? SCENARIOS.keys : ARGV
+names.each { |name| abort "scaling.rb: unknown scenario #{name}" unless SCENARIOS[name] }
+
+report = {}
+Dir.mktmpdir('mrc-scaling') do |dir|
+  names.each do |name|
+    generator, base, doublings = SCENARIOS[name]
+    sizes = (0..doublings).map { |i| base << i }
+    files = sizes.map do |size|
+      path = File.join(dir, "#{name}_#{size}.rb")
+      File.write(path, Generate.public_send(generator, size))
+      path
+    end
+    results = run_bench(bench, iterations, files)
+    ns = PHASES.to_h { |phase| [phase, results.map { |r| r[phase]['ns'] }] }
+    total = results.map { |r| PHASES.sum { |phase| r[phase]['ns'] } }
+    report[name] = {
+      'sizes' => sizes,
+      'ns' => total,
+      'exponent' => exponent(sizes, total),
+      'phases' => PHASES.to_h { |phase| [phase, exponent(sizes, ns[phase])] },
+    }
+  end
+end
+
+puts JSON.pretty_generate(report)
+slow = report.select { |_, r| r['exponent'] && r['exponent'] > threshold }
+slow.each { |name, r| warn "scaling.rb: #{name} grows as size**#{r['exponent']}" }
+exit(slow.empty? ? 0 : 1)
@@ -26,6 +26,44 @@ typedef struct mrc_filename_table {
   uint32_t start;
 } mrc_filename_table;
 
+/* compile statistics, filled while c->stats points at one (opt-in) */
+typedef struct mrc_stats {
+  uint64_t parse_ns;            /* Prism parse */
+  uint64_t codegen_ns;          /* mrc_generate_code(), debug_info_ns included */
+  uint64_t debug_info_ns;       /* building line tables */
+  uint64_t dump_ns;             /* mrc_dump_irep() */
+  size_t source_bytes;          /* parsed input, for MB/s */
+  uint32_t source_lines;        /* for ns/line */
+  uint32_t ireps;
+  uint32_t insns;               /* instructions, an OP_EXTn prefix with its op counted once */
+  uint32_t ext_ops;             /* OP_EXT1..3 prefixes */
+  uint32_t pool_entries;
+  uint32_t syms;
+  uint32_t nregs;               /* summed over ireps */
+  size_t iseq_bytes;
+  size_t dump_bytes;
+  /* allocations by phase: their number, the bytes they requested in total,
+     and the most bytes live at once above those live when the phase began
+     (the highest over repeated phases); always 0 unless the compiler is
+     built with MRC_ALLOC_STATS (see prism_xallocator.h) */
+  uint64_t parse_allocs;
+  uint64_t parse_alloc_bytes;
+  uint64_t parse_peak_bytes;
+  uint64_t codegen_allocs;
+  uint64_t codegen_alloc_bytes;
+  uint64_t codegen_peak_bytes;
+  uint64_t dump_allocs;
+  uint64_t dump_alloc_bytes;
+  uint64_t dump_peak_bytes;
+  /* dump_bytes by section, headers included; the rest is the binary
+     header and footer */
+  size_t irep_section_bytes;
+  size_t debug_section_bytes;
+  size_t lv_section_bytes;
+  size_t symtab_section_bytes;
+  size_t strtab_section_bytes;
+} mrc_stats;
+
 typedef struct mrc_ccontext {
   mrb_state *mrb;
   struct mrc_jmpbuf *jmp;
@@ -43,6 +81,11 @@ typedef struct mrc_ccontext {
   mrc_bool keep_lv:1;
   mrc_bool no_optimize:1;
   mrc_bool no_ext_ops:1;
+  /* input: compile `&:sym` to a lambda that sends the method instead of
+     calling Symbol#to_proc, so a redefined Symbol#to_proc is ignored. Off
+     by default; MRC_SYM_PROC builds and mrc-bench --sym-proc set it */
+  mrc_bool sym_proc:1;
+  mrc_bool diagnostic_count_only:1; /* input: count diagnostics without keeping them */
 #if defined(MRC_TARGET_MRUBY)
   const struct RProc *upper;
 #endif
@@ -50,6 +93,13 @@ typedef struct mrc_ccontext {
   // TODO
   //size_t parser_nerr;
   struct mrc_diagnostic_list *diagnostic_list;
+  struct mrc_diagnostic_list *diagnostic_tail;
+  uint32_t diagnostic_length;   /* entries in diagnostic_list */
+  uint32_t diagnostic_limit;    /* input: keep at most this many, 0 for no limit */
+  uint32_t diagnostic_counts[MRC_DIAGNOSTIC_CODE_COUNT]; /* output: per mrc_diagnostic_code */
+  struct mrc_position_resolver *positions; /* see mrc_position.h */
+  mrc_stats *stats;             /* input: NULL unless statistics are wanted */
+  struct mrc_trace *trace;      /* input: NULL unless a timeline is wanted, see mrc_trace.h */
 
   // For PICOIRB
   uint16_t scope_sp;
@@ -59,7 +109,6 @@ typedef struct mrc_ccontext {
 
   mrc_filename_table *filename_table;
   uint16_t filename_table_length;
-  uint16_t current_filename_index;
 #endif
 } mrc_ccontext;                 /* compiler context */
 
@@ -83,6 +132,15 @@ mrc_ccontext *mrc_ccontext_new(mrb_state *mrb);
 void mrc_ccontext_cleanup_local_variables(mrc_ccontext *c);
 const char *mrc_ccontext_filename(mrc_ccontext *c, const char *s);
 void mrc_ccontext_free(mrc_ccontext *c);
+/* zero c->stats, if any */
+MRC_API void mrc_ccontext_stats_reset(mrc_ccontext *c);
+/* monotonic nanoseconds for mrc_stats; 0 where no such clock is known */
+MRC_API uint64_t mrc_stats_clock(void);
+/* allocations made so far and their bytes, for the *_allocs fields */
+MRC_API void mrc_stats_allocs(uint64_t *count, uint64_t *bytes);
+/* bytes live now and the most live since the previous call, which restarts
+   that peak from now; for the *_peak_bytes fields */
+MRC_API void mrc_stats_live(uint64_t *live, uint64_t *peak);
 
 MRC_END_DECL
 
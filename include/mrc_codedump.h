@@ -2,11 +2,48 @@
 #define MRC_CODEDUMP_H
 
 #include "mrc_ccontext.h"
+#include "mrc_symtab.h"
 
 MRC_BEGIN_DECL
 
+/* number of opcodes, OP_EXTn included */
+enum {
+  MRC_CODESTATS_NOPS = 0
+#define OPCODE(x,_) + 1
+#include "mrc_ops.h"
+#undef OPCODE
+};
+
+/* nregs and nlocals at or above this share the last bucket */
+#define MRC_CODESTATS_REGS_MAX 256
+
+/* Bytecode statistics of an irep tree. An OP_EXTn prefix is counted in
+   `ext`, and the instruction it extends under its own opcode. */
+typedef struct mrc_codestats {
+  uint32_t ireps;
+  uint32_t insns;
+  size_t iseq_bytes;
+  uint32_t ops[MRC_CODESTATS_NOPS];
+  uint32_t ext[3];                          /* OP_EXT1..OP_EXT3 */
+  uint32_t ext_ops[MRC_CODESTATS_NOPS];     /* by the opcode extended */
+  uint32_t pairs[MRC_CODESTATS_NOPS][MRC_CODESTATS_NOPS]; /* [op][next op], within an irep */
+  uint32_t nregs[MRC_CODESTATS_REGS_MAX];
+  uint32_t nlocals[MRC_CODESTATS_REGS_MAX];
+  uint32_t pool[8];                         /* by IREP_TT_*, string lengths masked off */
+  /* method sends (OP_SEND*, OP_SSEND*) by symbol: sends.syms[i] has
+     send_counts[i] sites */
+  mrc_symtab sends;
+  uint32_t *send_counts;
+} mrc_codestats;
+
+/* NULL if out of memory */
+mrc_codestats *mrc_codestats_new(mrc_ccontext *c, const mrc_irep *irep);
+void mrc_codestats_free(mrc_ccontext *c, mrc_codestats *st);
+
 #ifndef MRC_NO_STDIO
 void mrc_codedump_all_file(mrc_ccontext *c, mrc_irep *irep, FILE *out);
+/* one JSON object; zero counts are left out */
+void mrc_codestats_dump_json(mrc_ccontext *c, const mrc_codestats *st, FILE *out);
 #endif
 
 void mrc_codedump_all(mrc_ccontext *c, mrc_irep *irep);
@@ -26,6 +26,12 @@ typedef struct mrc_irep_debug_info_line {
   uint16_t line;
 } mrc_irep_debug_info_line;
 
+/* pcs from start_pos up to the next run are on `line` */
+typedef struct mrc_irep_debug_line_run {
+  uint32_t start_pos;
+  int32_t line;
+} mrc_irep_debug_line_run;
+
 typedef struct mrc_irep_debug_info_file {
   uint32_t start_pos;
   mrc_sym filename_sym;
@@ -38,6 +44,9 @@ typedef struct mrc_irep_debug_info_file {
     const mrc_irep_debug_info_line *flat_map;
     const uint8_t *packed_map;
   } lines;
+  /* lookup index decoded from `lines` on first use; NULL until then */
+  uint32_t run_count;
+  mrc_irep_debug_line_run *runs;
 } mrc_irep_debug_info_file;
 
 typedef struct mrc_irep_debug_info {
@@ -64,11 +73,32 @@ int32_t mrc_debug_get_line(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc);
  */
 mrc_bool mrc_debug_get_position(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc, int32_t *lp, const char **fp);
 
-const char *mrc_debug_get_filename(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc);
+/*
+ * walk the line runs of an irep in pc order:
+ *
+ *   mrc_debug_line_iter it;
+ *   mrc_debug_line_iter_init(&it, irep);
+ *   while (mrc_debug_line_iter_next(c, &it)) {
+ *     ... pcs [it.start_pos, it.end_pos) are on it.line of it.filename_sym
+ *   }
+ */
+typedef struct mrc_debug_line_iter {
+  const mrc_irep *irep;
+  uint16_t file;
+  uint32_t run;
+  uint32_t start_pos, end_pos;
+  int32_t line;
+  mrc_sym filename_sym;
+} mrc_debug_line_iter;
+
+void mrc_debug_line_iter_init(mrc_debug_line_iter *it, const mrc_irep *irep);
+mrc_bool mrc_debug_line_iter_next(mrc_ccontext *c, mrc_debug_line_iter *it);
+
 mrc_irep_debug_info *mrc_debug_info_alloc(mrc_ccontext *c, mrc_irep *irep);
 mrc_irep_debug_info_file *mrc_debug_info_append_file(
     mrc_ccontext *c, mrc_irep_debug_info *info,
-    const char *filename, uint16_t *lines,
+    const char *filename,
+    const mrc_irep_debug_line_run *lines, uint32_t lines_len,
     uint32_t start_pos, uint32_t end_pos);
 void mrc_debug_info_free(mrc_ccontext *c, mrc_irep_debug_info *d);
 
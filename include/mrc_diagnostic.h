@@ -1,7 +1,7 @@
 #ifndef MRC_DIAGNOSTIC_H
 #define MRC_DIAGNOSTIC_H
 
-#include "mrc_ccontext.h"
+#include "mrc_common.h"
 
 MRC_BEGIN_DECL
 
@@ -12,9 +12,12 @@ typedef enum {
   MRC_GENERATOR_ERROR = 3,
 } mrc_diagnostic_code;
 
+#define MRC_DIAGNOSTIC_CODE_COUNT 4
+
 typedef struct mrc_diagnostic_list {
   mrc_diagnostic_code code;
-  char *message;
+  char *message;                /* "<code>, <text>" */
+  const char *text;             /* the message alone, inside `message` */
   const char *filename;
   uint32_t line;
   uint32_t column;
@@ -26,6 +29,23 @@ struct mrc_ccontext;
 void mrc_diagnostic_list_append(struct mrc_ccontext *c, const uint8_t *location_start, const char *message, mrc_diagnostic_code code);
 void mrc_diagnostic_list_free(struct mrc_ccontext *c);
 
+/* one kept diagnostic, as passed to mrc_diagnostic_each() */
+typedef struct mrc_diagnostic {
+  mrc_diagnostic_code code;
+  const char *filename;         /* NULL without a filename table */
+  uint32_t line;                /* 0 when the position is unknown */
+  uint32_t column;
+  const char *message;          /* without the code prefix */
+} mrc_diagnostic;
+
+/* return FALSE to stop the iteration */
+typedef mrc_bool mrc_diagnostic_func(const mrc_diagnostic *d, void *ud);
+
+void mrc_diagnostic_each(const struct mrc_ccontext *c, mrc_diagnostic_func *func, void *ud);
+/* every diagnostic reported with `code`, also those not kept because of
+   diagnostic_limit or diagnostic_count_only */
+uint32_t mrc_diagnostic_count(const struct mrc_ccontext *c, mrc_diagnostic_code code);
+
 MRC_END_DECL
 
 #endif // MRC_DIAGNOSTIC_H
@@ -8,12 +8,43 @@ MRC_BEGIN_DECL
 
 #define MRC_DUMP_DEBUG_INFO 1
 #define MRC_DUMP_STATIC 2
+/* write symbol names once, in a SYMT section, and refer to them from each
+   irep by 16-bit index; needs a loader for minor version 01 */
+#define MRC_DUMP_SYMTAB 4
+/* write pool strings used by more than one pool entry once, in a STRT
+   section; also needs a loader for minor version 01 */
+#define MRC_DUMP_STRTAB 8
+/* pad the IREP records so that, counted from the start of the image, every
+   iseq lands on MRC_DUMP_ALIGNMENT and every 8-byte pool value on 8; an image
+   mapped at an 8-byte boundary can then be used in place. The section is
+   written as RITE_SECTION_IREP_ALIGNED_IDENT; needs minor version 01 */
+#define MRC_DUMP_ALIGNED 16
+
+/* output formats of mrc_dump_irep_cfunc_format() */
+#define MRC_DUMP_CFUNC_ARRAY  0  /* brace-enclosed byte array (mrc_dump_irep_cfunc) */
+#define MRC_DUMP_CFUNC_STRING 1  /* one string literal; much faster to compile */
+#define MRC_DUMP_CFUNC_INCBIN 2  /* binary written to `binpath`, pulled in with .incbin */
 
 #ifndef MRC_NO_STDIO
 int mrc_dump_irep_cfunc(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *initname);
+int mrc_dump_irep_cfunc_format(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *initname, int format, const char *binpath);
 int mrc_dump_irep_binary(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE* fp);
 int mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bin, size_t *bin_size);
 #endif
+/* Copy the RITE image `bin` without its DBG and LVAR sections into `*out`
+   (allocated with mrc_malloc); every other section is kept byte for byte.
+   Works on already dumped images; for an irep tree use mrc_irep_strip(). */
+int mrc_dump_strip(mrc_ccontext *c, const uint8_t *bin, size_t bin_size, uint8_t **out, size_t *out_size);
+/* Read a RITE image back into a new irep tree. Symbols and filenames are
+   interned in `c`, so ireps read into one context can be linked together. */
+int mrc_read_irep(mrc_ccontext *c, const uint8_t *bin, size_t bin_size, mrc_irep **irepp);
+/* Make `n` top-level ireps the children of a new root irep that runs them in
+   order. Takes ownership of the ireps and of the `ireps` array itself
+   (allocated with mrc_malloc), also on failure. Dump the result with
+   MRC_DUMP_SYMTAB | MRC_DUMP_STRTAB to store shared symbols and strings once. */
+int mrc_link_irep(mrc_ccontext *c, mrc_irep **ireps, uint16_t n, mrc_irep **root);
+/* mrc_read_irep() every image, then mrc_link_irep() */
+int mrc_link_binaries(mrc_ccontext *c, const uint8_t *const *bins, const size_t *bin_sizes, uint16_t n, mrc_irep **root);
 
 /* dump/load error code
  *
@@ -39,6 +70,9 @@ int mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t
 #define RITE_BINARY_MAJOR_VER          "04"
 #define RITE_BINARY_MINOR_VER          "00"
 #define RITE_BINARY_FORMAT_VER         RITE_BINARY_MAJOR_VER RITE_BINARY_MINOR_VER
+/* minor version of binaries written with MRC_DUMP_SYMTAB, MRC_DUMP_STRTAB or
+   MRC_DUMP_ALIGNED */
+#define RITE_BINARY_MINOR_VER_EXT      "01"
 #if defined(RITE_COMPILER_NAME)
 #undef RITE_COMPILER_NAME
 #endif
@@ -50,8 +84,11 @@ int mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t
 
 #define RITE_BINARY_EOF                "END\0"
 #define RITE_SECTION_IREP_IDENT        "IREP"
+#define RITE_SECTION_IREP_ALIGNED_IDENT "IRPA"
 #define RITE_SECTION_DEBUG_IDENT       "DBG\0"
 #define RITE_SECTION_LV_IDENT          "LVAR"
+#define RITE_SECTION_SYMTAB_IDENT      "SYMT"
+#define RITE_SECTION_STRTAB_IDENT      "STRT"
 
 #define MRC_DUMP_DEFAULT_STR_LEN      128
 #define MRC_DUMP_ALIGNMENT            sizeof(uint32_t)
@@ -102,6 +139,26 @@ struct rite_binary_footer {
 
 #endif /* !MRUBY_DUMP_H */
 
+/* program-wide symbol table (MRC_DUMP_SYMTAB); written before the IREP
+   section. The header is followed by the number of symbols (uint16_t) and
+   then, for each, its length (uint16_t), name and a null char. The syms block
+   of every irep then holds uint16_t indexes into it, RITE_SYMTAB_NULL_INDEX
+   for a null symbol. */
+struct rite_section_symtab_header {
+  RITE_SECTION_HEADER;
+};
+
+#define RITE_SYMTAB_NULL_INDEX         UINT16_MAX
+
+/* program-wide string table (MRC_DUMP_STRTAB); written after SYMT, before
+   the IREP section, in the same layout. A pool entry of type
+   IREP_TT_SHARED_STR holds a uint16_t index into it. */
+struct rite_section_strtab_header {
+  RITE_SECTION_HEADER;
+};
+
+#define RITE_STRTAB_MAX                UINT16_MAX
+
 static inline size_t
 mrc_uint8_to_bin(uint8_t s, uint8_t *bin)
 {
@@ -16,6 +16,10 @@ MRC_BEGIN_DECL
 
 #define IREP_TT_NFLAG 1       /* number (non string) flag */
 #define IREP_TT_SFLAG 2       /* static string flag */
+/* pool entry type of the RITE binary only: a string kept in the STRT section,
+   referred to by a uint16_t index (MRC_DUMP_STRTAB). A string kind, so bit 0
+   (IREP_TT_NFLAG) is clear; no irep_pool_type uses 4. */
+#define IREP_TT_SHARED_STR 4
 
 typedef struct mrc_pool_value {
   uint32_t tt;     /* packed type and length (for string) */
@@ -83,6 +87,10 @@ struct mrc_insn_data {
 #define mrc_irep_catch_handler_unpack(v)    mrc_bin_to_uint32(v)
 
 void mrc_irep_remove_lv(mrc_ccontext *c, mrc_irep *irep);
+/* drop the debug info and local variable names of the whole tree, so that a
+   dump has neither DBG nor LVAR section, and the pool entries and symbols
+   that no instruction refers to */
+void mrc_irep_strip(mrc_ccontext *c, mrc_irep *irep);
 void mrc_irep_free(mrc_ccontext *c, mrc_irep *irep);
 
 #define MRC_ASPEC_REQ(a)          (((a) >> 18) & 0x1f)
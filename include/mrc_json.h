@@ -0,0 +1,20 @@
+#ifndef MRC_JSON_H
+#define MRC_JSON_H
+
+#include "mrc_common.h"
+
+#ifndef MRC_NO_STDIO
+#include <stddef.h>
+#include <stdio.h>
+
+MRC_BEGIN_DECL
+
+/* `len` bytes of `s` as a quoted JSON string, for the JSON reports of the
+   code statistics, the trace and mrc-bench */
+MRC_API void mrc_json_string(const char *s, size_t len, FILE *out);
+
+MRC_END_DECL
+
+#endif // MRC_NO_STDIO
+
+#endif // MRC_JSON_H
@@ -0,0 +1,35 @@
+#ifndef MRC_POSITION_H
+#define MRC_POSITION_H
+
+#include "mrc_ccontext.h"
+
+MRC_BEGIN_DECL
+
+/* Maps source pointers of the current parse to (file, line, column). The
+   first line of every input file is looked up once, lines come from Prism's
+   newline list, and the last answer is kept as a cursor because codegen
+   visits nodes mostly in source order. Built on first use and rebuilt when
+   the parser or the filename table changes. */
+typedef struct mrc_position_resolver {
+  const uint8_t *source;        /* parser start it was built for */
+  size_t newline_count;         /* newline list size it was built for */
+  const void *table;            /* filename table it was built for */
+  uint16_t file_count;
+  size_t *file_lines;           /* newline list index of each file's first line */
+  uint16_t file;                /* cursor */
+  size_t line;
+} mrc_position_resolver;
+
+typedef struct mrc_position {
+  uint16_t file;                /* index into c->filename_table, 0 without one */
+  uint32_t line;                /* 1-based, within that file */
+  uint32_t column;              /* 1-based, in bytes */
+} mrc_position;
+
+/* FALSE if `pos` is NULL or outside the source */
+mrc_bool mrc_position_resolve(mrc_ccontext *c, const uint8_t *pos, mrc_position *out);
+void mrc_position_resolver_free(mrc_ccontext *c);
+
+MRC_END_DECL
+
+#endif // MRC_POSITION_H
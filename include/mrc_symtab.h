@@ -0,0 +1,29 @@
+#ifndef MRC_SYMTAB_H
+#define MRC_SYMTAB_H
+
+#include "mrc_ccontext.h"
+
+MRC_BEGIN_DECL
+
+/* Insertion-ordered set of symbols. `syms` keeps the first-seen order, which
+   is the order the dumpers write their tables in; `slots` is an
+   open-addressing index into it, so registering and looking up a symbol do
+   not scan the table. Zero-initialize to get an empty set. */
+typedef struct mrc_symtab {
+  mrc_sym *syms;
+  uint32_t len;
+  uint32_t capa;
+  uint32_t *slots;              /* index into syms plus one; 0 is empty */
+  uint32_t slot_capa;           /* power of two */
+} mrc_symtab;
+
+/* index of `sym`, or -1 if it is not registered */
+int32_t mrc_symtab_find(const mrc_symtab *t, mrc_sym sym);
+/* register `sym` and return its index; `added` (may be NULL) tells whether it
+   was new */
+uint32_t mrc_symtab_add(mrc_ccontext *c, mrc_symtab *t, mrc_sym sym, mrc_bool *added);
+void mrc_symtab_free(mrc_ccontext *c, mrc_symtab *t);
+
+MRC_END_DECL
+
+#endif // MRC_SYMTAB_H
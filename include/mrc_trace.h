@@ -0,0 +1,45 @@
+#ifndef MRC_TRACE_H
+#define MRC_TRACE_H
+
+#include "mrc_ccontext.h"
+
+MRC_BEGIN_DECL
+
+/* Timeline of one compile: parse, every codegen scope and dump, as begin
+   and end events. Opt-in like mrc_stats: point c->trace at a zeroed
+   mrc_trace, compile, then write it with mrc_trace_dump_json() before the
+   context is freed (the file names belong to it). An end event carries
+   the allocations made since its begin when built with MRC_ALLOC_STATS,
+   and that of a codegen scope the sizes of the irep it built. */
+typedef struct mrc_trace_event {
+  const char *name;             /* static string */
+  const char *file;             /* NULL if not known */
+  uint32_t line;
+  char ph;                      /* 'B' or 'E' */
+  uint64_t ns;                  /* mrc_stats_clock() */
+  uint64_t allocs;              /* mrc_stats_allocs() */
+  uint64_t alloc_bytes;
+  uint32_t ilen;                /* irep sizes; 0 but for a scope's 'E' */
+  uint16_t plen, slen;
+} mrc_trace_event;
+
+typedef struct mrc_trace {
+  mrc_trace_event *events;
+  uint32_t len;
+  uint32_t capa;
+} mrc_trace;
+
+/* no-ops while c->trace is NULL; an event is dropped if memory runs out */
+void mrc_trace_begin(mrc_ccontext *c, const char *name, const char *file, uint32_t line);
+void mrc_trace_end(mrc_ccontext *c, const char *name);
+void mrc_trace_end_irep(mrc_ccontext *c, const char *name, uint32_t ilen, uint16_t plen, uint16_t slen);
+/* free the events; `t` itself is the caller's */
+void mrc_trace_release(mrc_ccontext *c, mrc_trace *t);
+#ifndef MRC_NO_STDIO
+/* Chrome trace-event JSON, timestamps in microseconds from the first event */
+void mrc_trace_dump_json(const mrc_trace *t, FILE *out);
+#endif
+
+MRC_END_DECL
+
+#endif // MRC_TRACE_H
@@ -1,54 +1,99 @@
 #ifndef PRISM_CUSTOM_ALLOCATOR_H
 #define PRISM_CUSTOM_ALLOCATOR_H
 
+#if defined(MRC_ALLOC_STATS)
+  #include <stddef.h>
+
+  /* Benchmark builds count every allocation of the compiler and of Prism in
+     mrc_alloc_counts (defined in ccontext.c). A realloc counts as one
+     allocation of its new size. `live` follows the blocks the compiler and
+     Prism free themselves; a block freed by the VM instead stays live until
+     its address is handed out again. Not thread safe. */
+  typedef struct mrc_alloc_counter {
+    unsigned long long count;
+    unsigned long long bytes;
+    unsigned long long live;    /* bytes allocated and not freed yet */
+    unsigned long long peak;    /* highest `live` since mrc_stats_live() */
+  } mrc_alloc_counter;
+  /* Prism stays C in an MRB_USE_CXX_ABI build, so keep C linkage */
+  #ifdef __cplusplus
+  extern "C" {
+  #endif
+  extern mrc_alloc_counter mrc_alloc_counts;
+  void *mrc_alloc_track_(void *ret, void *old, size_t size);
+  void *mrc_free_track_(void *ptr);
+  #ifdef __cplusplus
+  }
+  #endif
+
+  static inline size_t
+  mrc_alloc_count_(size_t nmemb, size_t size, size_t ret)
+  {
+    mrc_alloc_counts.count++;
+    mrc_alloc_counts.bytes += (unsigned long long)nmemb * size;
+    return ret;
+  }
+  #define MRC_ALLOC_COUNT(size)       mrc_alloc_count_(1, size, size)
+  #define MRC_ALLOC_COUNT_N(n,size)   mrc_alloc_count_(n, size, n)
+  /* `ret` is the block the allocator returned for `size` bytes, in place of
+     `old` for a realloc */
+  #define MRC_ALLOC_TRACK(ret,old,size)  mrc_alloc_track_(ret, old, size)
+  #define MRC_FREE_TRACK(ptr)         mrc_free_track_(ptr)
+#else
+  #define MRC_ALLOC_COUNT(size)       (size)
+  #define MRC_ALLOC_COUNT_N(n,size)   (n)
+  #define MRC_ALLOC_TRACK(ret,old,size)  (ret)
+  #define MRC_FREE_TRACK(ptr)         (ptr)
+#endif
+
 #if defined(MRC_TARGET_MRUBY)
   #include "mruby.h"
 
   #if defined(MRC_ALLOC_LIBC)
-    #define xmalloc(size)             malloc(size)
-    #define xcalloc(nmemb,size)       calloc(nmemb, size)
-    #define xrealloc(nmemb,size)      realloc(nmemb, size)
-    #define xfree(ptr)                free(ptr)
+    #define xmalloc(size)             MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define xcalloc(nmemb,size)       MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define xrealloc(nmemb,size)      MRC_ALLOC_TRACK(realloc(nmemb, MRC_ALLOC_COUNT(size)), nmemb, size)
+    #define xfree(ptr)                free(MRC_FREE_TRACK(ptr))
 
-    #define mrc_malloc(c,size)        malloc(size)
-    #define mrc_calloc(c,nmemb,size)  calloc(nmemb, size)
-    #define mrc_realloc(c,ptr,size)   realloc(ptr, size)
-    #define mrc_free(c,ptr)           free(ptr)
+    #define mrc_malloc(c,size)        MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define mrc_calloc(c,nmemb,size)  MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define mrc_realloc(c,ptr,size)   MRC_ALLOC_TRACK(realloc(ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+    #define mrc_free(c,ptr)           free(MRC_FREE_TRACK(ptr))
   #else
     extern mrb_state *global_mrb;
 
-    #define xmalloc(size)             mrb_malloc(global_mrb, size)
-    #define xcalloc(nmemb,size)       mrb_calloc(global_mrb, nmemb, size)
-    #define xrealloc(ptr,size)        mrb_realloc(global_mrb, ptr, size)
-    #define xfree(ptr)                mrb_free(global_mrb, ptr)
+    #define xmalloc(size)             MRC_ALLOC_TRACK(mrb_malloc(global_mrb, MRC_ALLOC_COUNT(size)), NULL, size)
+    #define xcalloc(nmemb,size)       MRC_ALLOC_TRACK(mrb_calloc(global_mrb, MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define xrealloc(ptr,size)        MRC_ALLOC_TRACK(mrb_realloc(global_mrb, ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+    #define xfree(ptr)                mrb_free(global_mrb, MRC_FREE_TRACK(ptr))
 
-    #define mrc_malloc(c,size)        mrb_malloc(c->mrb, size)
-    #define mrc_calloc(c,nmemb,size)  mrb_calloc(c->mrb, nmemb, size)
-    #define mrc_realloc(c,ptr,size)   mrb_realloc(c->mrb, ptr, size)
-    #define mrc_free(c,ptr)           mrb_free(c->mrb, ptr)
+    #define mrc_malloc(c,size)        MRC_ALLOC_TRACK(mrb_malloc(c->mrb, MRC_ALLOC_COUNT(size)), NULL, size)
+    #define mrc_calloc(c,nmemb,size)  MRC_ALLOC_TRACK(mrb_calloc(c->mrb, MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define mrc_realloc(c,ptr,size)   MRC_ALLOC_TRACK(mrb_realloc(c->mrb, ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+    #define mrc_free(c,ptr)           mrb_free(c->mrb, MRC_FREE_TRACK(ptr))
   #endif
 #elif defined(MRC_TARGET_MRUBYC)
   #include "mrubyc.h"
   #if defined(MRBC_ALLOC_LIBC)
-    #define xmalloc(size)             malloc(size)
-    #define xcalloc(nmemb,size)       calloc(nmemb, size)
-    #define xrealloc(nmemb,size)      realloc(nmemb, size)
-    #define xfree(ptr)                free(ptr)
+    #define xmalloc(size)             MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define xcalloc(nmemb,size)       MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define xrealloc(nmemb,size)      MRC_ALLOC_TRACK(realloc(nmemb, MRC_ALLOC_COUNT(size)), nmemb, size)
+    #define xfree(ptr)                free(MRC_FREE_TRACK(ptr))
 
-    #define mrc_malloc(c,size)        malloc(size)
-    #define mrc_calloc(c,nmemb,size)  calloc(nmemb, size)
-    #define mrc_realloc(c,ptr,size)   realloc(ptr, size)
-    #define mrc_free(c,ptr)           free(ptr)
+    #define mrc_malloc(c,size)        MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define mrc_calloc(c,nmemb,size)  MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define mrc_realloc(c,ptr,size)   MRC_ALLOC_TRACK(realloc(ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+    #define mrc_free(c,ptr)           free(MRC_FREE_TRACK(ptr))
   #else
-    #define xmalloc(size)             mrbc_raw_alloc(size)
-    #define xcalloc(nmemb,size)       mrbc_raw_calloc(nmemb, size)
-    #define xrealloc(nmemb,size)      mrc_raw_realloc(nmemb, size)
-    #define xfree(ptr)                mrc_raw_free(ptr)
+    #define xmalloc(size)             MRC_ALLOC_TRACK(mrbc_raw_alloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define xcalloc(nmemb,size)       MRC_ALLOC_TRACK(mrbc_raw_calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define xrealloc(nmemb,size)      MRC_ALLOC_TRACK(mrc_raw_realloc(nmemb, MRC_ALLOC_COUNT(size)), nmemb, size)
+    #define xfree(ptr)                mrc_raw_free(MRC_FREE_TRACK(ptr))
 
-    #define mrc_malloc(c,size)        mrbc_raw_alloc(size)
-    #define mrc_calloc(c,nmemb,size)  mrbc_raw_calloc(nmemb, size)
-    #define mrc_realloc(c,ptr,size)   mrc_raw_realloc(ptr, size)
-    #define mrc_free(c,ptr)           mrc_raw_free(ptr)
+    #define mrc_malloc(c,size)        MRC_ALLOC_TRACK(mrbc_raw_alloc(MRC_ALLOC_COUNT(size)), NULL, size)
+    #define mrc_calloc(c,nmemb,size)  MRC_ALLOC_TRACK(mrbc_raw_calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+    #define mrc_realloc(c,ptr,size)   MRC_ALLOC_TRACK(mrc_raw_realloc(ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+    #define mrc_free(c,ptr)           mrc_raw_free(MRC_FREE_TRACK(ptr))
 
     static inline void mrc_raw_free(void *ptr)
     {
@@ -71,14 +116,14 @@
 #else
 
   // for standalone mrbc in PicoRuby
-  #define mrc_malloc(c,size)        malloc(size)
-  #define mrc_calloc(c,nmemb,size)  calloc(nmemb, size)
-  #define mrc_realloc(c,ptr,size)   realloc(ptr, size)
-  #define mrc_free(c,ptr)           free(ptr)
-  #define xmalloc(size)             malloc(size)
-  #define xcalloc(nmemb,size)       calloc(nmemb, size)
-  #define xrealloc(ptr,size)        realloc(ptr, size)
-  #define xfree(ptr)                free(ptr)
+  #define mrc_malloc(c,size)        MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+  #define mrc_calloc(c,nmemb,size)  MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+  #define mrc_realloc(c,ptr,size)   MRC_ALLOC_TRACK(realloc(ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+  #define mrc_free(c,ptr)           free(MRC_FREE_TRACK(ptr))
+  #define xmalloc(size)             MRC_ALLOC_TRACK(malloc(MRC_ALLOC_COUNT(size)), NULL, size)
+  #define xcalloc(nmemb,size)       MRC_ALLOC_TRACK(calloc(MRC_ALLOC_COUNT_N(nmemb, size), size), NULL, (nmemb) * (size))
+  #define xrealloc(ptr,size)        MRC_ALLOC_TRACK(realloc(ptr, MRC_ALLOC_COUNT(size)), ptr, size)
+  #define xfree(ptr)                free(MRC_FREE_TRACK(ptr))
 
 #endif
 
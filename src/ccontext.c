@@ -1,6 +1,9 @@
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "../include/mrc_ccontext.h"
 #include "../include/mrc_parser_util.h"
+#include "../include/mrc_position.h"
 
 #if defined(MRC_TARGET_MRUBY)
 /* The Prism xallocator routes allocations through this mrb_state. Define it
@@ -11,6 +14,126 @@
 mrb_state *global_mrb = NULL;
 #endif
 
+#if defined(MRC_ALLOC_STATS)
+mrc_alloc_counter mrc_alloc_counts;
+
+/* The size of every live block by its address, for mrc_alloc_counts.live.
+   Open addressing with linear probing, on libc memory so that the table
+   does not count itself. */
+static struct {
+  uintptr_t *keys;              /* 0 for an empty slot */
+  size_t *sizes;
+  size_t capa;                  /* a power of 2 */
+  size_t len;
+} alloc_sizes;
+
+static size_t
+alloc_home(uintptr_t key)
+{
+  return (size_t)((key >> 3) * 2654435761U) & (alloc_sizes.capa - 1);
+}
+
+static size_t
+alloc_slot(uintptr_t key)
+{
+  size_t i = alloc_home(key);
+
+  while (alloc_sizes.keys[i] != 0 && alloc_sizes.keys[i] != key) {
+    i = (i + 1) & (alloc_sizes.capa - 1);
+  }
+  return i;
+}
+
+static mrc_bool
+alloc_grow(void)
+{
+  uintptr_t *keys = alloc_sizes.keys;
+  size_t *sizes = alloc_sizes.sizes;
+  size_t capa = alloc_sizes.capa;
+  size_t new_capa = capa ? capa * 2 : 1024;
+
+  alloc_sizes.keys = (uintptr_t *)calloc(new_capa, sizeof(uintptr_t));
+  alloc_sizes.sizes = (size_t *)malloc(new_capa * sizeof(size_t));
+  if (alloc_sizes.keys == NULL || alloc_sizes.sizes == NULL) {
+    free(alloc_sizes.keys);
+    free(alloc_sizes.sizes);
+    alloc_sizes.keys = keys;
+    alloc_sizes.sizes = sizes;
+    return FALSE;
+  }
+  alloc_sizes.capa = new_capa;
+  for (size_t i = 0; i < capa; i++) {
+    if (keys[i] != 0) {
+      size_t j = alloc_slot(keys[i]);
+      alloc_sizes.keys[j] = keys[i];
+      alloc_sizes.sizes[j] = sizes[i];
+    }
+  }
+  free(keys);
+  free(sizes);
+  return TRUE;
+}
+
+static void
+alloc_forget(uintptr_t key)
+{
+  size_t mask = alloc_sizes.capa - 1;
+  size_t i, j;
+
+  if (alloc_sizes.len == 0) return;
+  i = alloc_slot(key);
+  if (alloc_sizes.keys[i] == 0) return;   /* not ours, e.g. from the VM */
+  mrc_alloc_counts.live -= alloc_sizes.sizes[i];
+  alloc_sizes.len--;
+  /* pull back the entries of the probe run that follows */
+  for (j = (i + 1) & mask; alloc_sizes.keys[j] != 0; j = (j + 1) & mask) {
+    size_t home = alloc_home(alloc_sizes.keys[j]);
+    if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+    alloc_sizes.keys[i] = alloc_sizes.keys[j];
+    alloc_sizes.sizes[i] = alloc_sizes.sizes[j];
+    i = j;
+  }
+  alloc_sizes.keys[i] = 0;
+}
+
+static void
+alloc_remember(uintptr_t key, size_t size)
+{
+  size_t i;
+
+  if (alloc_sizes.len * 2 >= alloc_sizes.capa && !alloc_grow()) return;
+  i = alloc_slot(key);
+  if (alloc_sizes.keys[i] != 0) {
+    /* the VM freed this block without telling us */
+    mrc_alloc_counts.live -= alloc_sizes.sizes[i];
+  }
+  else {
+    alloc_sizes.len++;
+  }
+  alloc_sizes.keys[i] = key;
+  alloc_sizes.sizes[i] = size;
+  mrc_alloc_counts.live += size;
+  if (mrc_alloc_counts.live > mrc_alloc_counts.peak) {
+    mrc_alloc_counts.peak = mrc_alloc_counts.live;
+  }
+}
+
+void *
+mrc_alloc_track_(void *ret, void *old, size_t size)
+{
+  if (old != NULL && (ret != NULL || size == 0)) alloc_forget((uintptr_t)old);
+  if (ret != NULL) alloc_remember((uintptr_t)ret, size);
+  return ret;
+}
+
+void *
+mrc_free_track_(void *ptr)
+{
+  if (ptr != NULL) alloc_forget((uintptr_t)ptr);
+  return ptr;
+}
+#endif
+
 MRC_API mrc_ccontext *
 mrc_ccontext_new(mrb_state *mrb)
 {
@@ -78,9 +201,49 @@ mrc_ccontext_free(mrc_ccontext *c)
   if (c->filename) mrc_free(c, c->filename);
   pm_parser_free(c->p);
   mrc_diagnostic_list_free(c);
-  if (c->p->lex_callback) {
-    mrc_free(c, c->p->lex_callback);
-  }
+  mrc_position_resolver_free(c);
   mrc_free(c, c->p);
   mrc_free(c, c);
 }
+
+MRC_API void
+mrc_ccontext_stats_reset(mrc_ccontext *c)
+{
+  if (c->stats) memset(c->stats, 0, sizeof(mrc_stats));
+}
+
+MRC_API uint64_t
+mrc_stats_clock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return 0;
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+MRC_API void
+mrc_stats_allocs(uint64_t *count, uint64_t *bytes)
+{
+#if defined(MRC_ALLOC_STATS)
+  *count = mrc_alloc_counts.count;
+  *bytes = mrc_alloc_counts.bytes;
+#else
+  *count = *bytes = 0;
+#endif
+}
+
+MRC_API void
+mrc_stats_live(uint64_t *live, uint64_t *peak)
+{
+#if defined(MRC_ALLOC_STATS)
+  *live = mrc_alloc_counts.live;
+  *peak = mrc_alloc_counts.peak;
+  mrc_alloc_counts.peak = mrc_alloc_counts.live;
+#else
+  *live = *peak = 0;
+#endif
+}
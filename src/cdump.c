@@ -6,11 +6,13 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include "../include/mrc_ccontext.h"
 #include "../include/mrc_irep.h"
 #include "../include/mrc_dump.h"
 #include "../include/mrc_debug.h"
 #include "../include/mrc_irep_pool_type.h"
+#include "../include/mrc_symtab.h"
 
 #ifndef MRC_NO_STDIO
 
@@ -63,19 +65,35 @@ mrc_str_new_cstr(mrc_ccontext *c, const char *cstr)
   return mrc_str_new(c, cstr, strlen(cstr));
 }
 
+/* grow geometrically, so that building init_syms_code one line at a time
+   stays linear */
 static void
-mrc_str_cat_lit(mrc_ccontext *c, mrc_string *s, const char *lit)
+mrc_str_reserve(mrc_ccontext *c, mrc_string *s, size_t len)
 {
-  size_t len = strlen(lit);
-  if (s->len+len+1 > s->capa) {
-    s->capa = s->len+len+1;
-    s->ptr = (char *)mrc_realloc(c, s->ptr, s->capa);
-  }
-  memcpy(s->ptr+s->len, lit, len);
+  size_t capa = s->capa;
+
+  if (s->len+len+1 <= capa) return;
+  if (capa < 16) capa = 16;
+  while (capa < s->len+len+1) capa *= 2;
+  s->ptr = (char *)mrc_realloc(c, s->ptr, capa);
+  s->capa = capa;
+}
+
+static void
+mrc_str_cat(mrc_ccontext *c, mrc_string *s, const char *ptr, size_t len)
+{
+  mrc_str_reserve(c, s, len);
+  memcpy(s->ptr+s->len, ptr, len);
   s->len += len;
   s->ptr[s->len] = '\0';
 }
 
+static void
+mrc_str_cat_lit(mrc_ccontext *c, mrc_string *s, const char *lit)
+{
+  mrc_str_cat(c, s, lit, strlen(lit));
+}
+
 static void
 mrc_str_cat_cstr(mrc_ccontext *c, mrc_string *s, const char *cstr)
 {
@@ -86,13 +104,7 @@ mrc_str_cat_cstr(mrc_ccontext *c, mrc_string *s, const char *cstr)
 static void
 mrc_str_cat_str(mrc_ccontext *c, mrc_string *s, mrc_string *s2)
 {
-  if (s->len+s2->len+1 > s->capa) {
-    s->capa = s->len+s2->len+1;
-    s->ptr = (char *)mrc_realloc(c, s->ptr, s->capa);
-  }
-  memcpy(s->ptr+s->len, s2->ptr, s2->len);
-  s->len += s2->len;
-  s->ptr[s->len] = '\0';
+  mrc_str_cat(c, s, s2->ptr, s2->len);
 }
 
 static void
@@ -102,21 +114,35 @@ mrc_str_free(mrc_ccontext *c, mrc_string *s)
   mrc_free(c, s);
 }
 
+/* a C string literal of `s`; bytes that cannot appear in one as they are
+   become three digit octal escapes, which cannot absorb a following digit */
 static mrc_string*
 mrc_str_escape(mrc_ccontext *c, mrc_string *s)
 {
-  mrc_string *s2 = mrc_str_new_capa(c, s->len*2+1);
-  mrc_str_cat_lit(c, s2, "\"");
-  if (s2) {
-    for (size_t i=0; i<s->len; i++) {
-      char ch[2] = {s->ptr[i], '\0'};
-      if (ch[0] == '"' || ch[0] == '\\') {
-        mrc_str_cat_lit(c, s2, "\\");
-      }
-      mrc_str_cat_lit(c, s2, ch);
+  mrc_string *s2 = mrc_str_new_capa(c, s->len*4+3);
+  if (!s2) return NULL;
+
+  char *p = s2->ptr;
+  *p++ = '"';
+  for (size_t i=0; i<s->len; i++) {
+    unsigned char ch = (unsigned char)s->ptr[i];
+    if (ch == '"' || ch == '\\' || ch == '?') {
+      *p++ = '\\';
+      *p++ = (char)ch;
+    }
+    else if (0x20 <= ch && ch < 0x7f) {
+      *p++ = (char)ch;
+    }
+    else {
+      *p++ = '\\';
+      *p++ = (char)('0' + (ch >> 6));
+      *p++ = (char)('0' + ((ch >> 3) & 7));
+      *p++ = (char)('0' + (ch & 7));
     }
   }
-  mrc_str_cat_lit(c, s2, "\"");
+  *p++ = '"';
+  *p = '\0';
+  s2->len = p - s2->ptr;
   return s2;
 }
 
@@ -286,8 +312,12 @@ sym_var_name_str(mrc_ccontext *c, const char *initname, const char *key, int n)
   return s;
 }
 
+/* Symbols without a presym are interned at run time. Each distinct one gets
+   a slot in the shared `<initname>_symtab`, which _init_syms interns once,
+   and every irep symbol array that refers to it records a (slot in the
+   array, index into the table) pair in its fixup list. */
 static int
-cdump_sym(mrc_ccontext *c, mrc_sym sym, const char *var_name, int idx, mrc_string *init_syms_code, FILE *fp)
+cdump_sym(mrc_ccontext *c, mrc_sym sym, int idx, mrc_symtab *symtab, mrc_string *fixup, FILE *fp)
 {
   if (sym == 0) {
     fputs("0,", fp);
@@ -327,17 +357,9 @@ cdump_sym(mrc_ccontext *c, mrc_sym sym, const char *var_name, int idx, mrc_strin
   }
   else {
     char buf[32];
-    mrc_string *name_obj = mrc_str_new(c, name, len);
-    mrc_str_cat_lit(c, init_syms_code, "  ");
-    mrc_str_cat_cstr(c, init_syms_code, var_name);
-    snprintf(buf, sizeof(buf), "[%d] = ", idx);
-    mrc_str_cat_cstr(c, init_syms_code, buf);
-    mrc_str_cat_lit(c, init_syms_code, "mrb_intern_lit(mrb, ");
-    mrc_string *escaped = mrc_str_escape(c, name_obj);
-    mrc_str_free(c, name_obj);
-    mrc_str_cat_str(c, init_syms_code, escaped);
-    mrc_str_free(c, escaped);
-    mrc_str_cat_lit(c, init_syms_code, ");\n");
+    uint32_t table_idx = mrc_symtab_add(c, symtab, sym, NULL);
+    snprintf(buf, sizeof(buf), "%d,%" PRIu32 ",", idx, table_idx);
+    mrc_str_cat_cstr(c, fixup, buf);
     fputs("0", fp);
   }
   fputs(", ", fp);
@@ -346,16 +368,16 @@ cdump_sym(mrc_ccontext *c, mrc_sym sym, const char *var_name, int idx, mrc_strin
 }
 
 static int
-cdump_syms(mrc_ccontext *c, const char *name, const char *key, int n, int syms_len, const mrc_sym *syms, mrc_string *init_syms_code, FILE *fp)
+cdump_syms(mrc_ccontext *c, const char *name, const char *key, int n, int syms_len, const mrc_sym *syms, mrc_symtab *symtab, mrc_string *init_syms_code, FILE *fp)
 {
   int ai = mrc_gc_arena_save(c);
-  size_t code_len = MRC_STRING_LEN(init_syms_code);
   mrc_string *var_name = sym_var_name_str(c, name, key, n);
+  mrc_string *fixup = mrc_str_new_capa(c, 1);
 
   fprintf(fp, "mrb_DEFINE_SYMS_VAR(%s, %d, (", MRC_STRING_PTR(var_name), syms_len);
   int emitted = 0;
   for (int i=0; i<syms_len; i++) {
-    if (cdump_sym(c, syms[i], MRC_STRING_PTR(var_name), i, init_syms_code, fp) == MRC_DUMP_OK) {
+    if (cdump_sym(c, syms[i], i, symtab, fixup, fp) == MRC_DUMP_OK) {
       emitted++;
     }
   }
@@ -363,10 +385,22 @@ cdump_syms(mrc_ccontext *c, const char *name, const char *key, int n, int syms_l
      MSVC fails with C2059). Emit a single 0 so the array is validly
      zero-initialized; runtime-interned symbols are still filled by init code. */
   if (emitted == 0) fputs("0", fp);
-  mrc_str_free(c, var_name);
   fputs("), ", fp);
-  if (code_len == MRC_STRING_LEN(init_syms_code)) fputs("const", fp);
+  if (MRC_STRING_LEN(fixup) == 0) fputs("const", fp);
   fputs(");\n", fp);
+  if (MRC_STRING_LEN(fixup) > 0) {
+    fprintf(fp, "static const uint32_t %s_fixup[] = {%s};\n",
+            MRC_STRING_PTR(var_name), MRC_STRING_PTR(fixup));
+    mrc_str_cat_lit(c, init_syms_code, "  mrb_FIXUP_SYMS(");
+    mrc_str_cat_str(c, init_syms_code, var_name);
+    mrc_str_cat_lit(c, init_syms_code, ", ");
+    mrc_str_cat_str(c, init_syms_code, var_name);
+    mrc_str_cat_lit(c, init_syms_code, "_fixup, ");
+    mrc_str_cat_cstr(c, init_syms_code, name);
+    mrc_str_cat_lit(c, init_syms_code, "_symtab);\n");
+  }
+  mrc_str_free(c, fixup);
+  mrc_str_free(c, var_name);
   mrc_gc_arena_restore(c, ai);
   return MRC_DUMP_OK;
 }
@@ -387,7 +421,7 @@ simple_debug_info(mrc_irep_debug_info *info)
 //adds filenames in init_syms_code block
 static int
 cdump_debug(mrc_ccontext *c, const char *name, int n, mrc_irep_debug_info *info,
-            mrc_string *init_syms_code, FILE *fp)
+            mrc_symtab *symtab, mrc_string *init_syms_code, FILE *fp)
 {
   int ai = mrc_gc_arena_save(c);
   char buffer[256];
@@ -398,16 +432,10 @@ cdump_debug(mrc_ccontext *c, const char *name, int n, mrc_irep_debug_info *info,
 
   int len = info->files[0]->line_entry_count;
 
-  const pm_constant_t *fn_constant = pm_constant_pool_id_to_constant(&c->p->constant_pool, info->files[0]->filename_sym);
-  const char *filename = (const char *)fn_constant->start;
-  snprintf(buffer, sizeof(buffer), "  %s_debug_file_%d.filename_sym = mrb_intern_lit(mrb,", name, n);
+  uint32_t filename_idx = mrc_symtab_add(c, symtab, info->files[0]->filename_sym, NULL);
+  snprintf(buffer, sizeof(buffer), "  %s_debug_file_%d.filename_sym = %s_symtab[%" PRIu32 "];\n",
+           name, n, name, filename_idx);
   mrc_str_cat_cstr(c, init_syms_code, buffer);
-  mrc_string *filename_str = mrc_str_new_cstr(c, filename);
-  mrc_string *escaped = mrc_str_escape(c, filename_str);
-  mrc_str_free(c, filename_str);
-  mrc_str_cat_str(c, init_syms_code, escaped);
-  mrc_str_free(c, escaped);
-  mrc_str_cat_cstr(c, init_syms_code, ");\n");
 
   switch (info->files[0]->line_type) {
   case mrc_debug_line_ary:
@@ -456,7 +484,7 @@ cdump_debug(mrc_ccontext *c, const char *name, int n, mrc_irep_debug_info *info,
 }
 
 static int
-cdump_irep_struct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *name, int n, mrc_string *init_syms_code, int *mp)
+cdump_irep_struct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *name, int n, mrc_symtab *symtab, mrc_string *init_syms_code, int *mp)
 {
   int i, len;
   int max = *mp;
@@ -466,7 +494,7 @@ cdump_irep_struct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp
   if (0 < irep->rlen) {
     for (i=0,len=irep->rlen; i<len; i++) {
       *mp += len;
-      if (cdump_irep_struct(c, irep->reps[i], flags, fp, name, max+i, init_syms_code, mp) != MRC_DUMP_OK)
+      if (cdump_irep_struct(c, irep->reps[i], flags, fp, name, max+i, symtab, init_syms_code, mp) != MRC_DUMP_OK)
         return MRC_DUMP_INVALID_ARGUMENT;
     }
     fprintf(fp,   "static const mrb_irep *%s_reps_%d[%d] = {\n", name, n, len);
@@ -487,7 +515,7 @@ cdump_irep_struct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp
   }
   /* dump syms */
   if (0 < irep->slen) {
-    cdump_syms(c, name, "syms", n, irep->slen, irep->syms, init_syms_code, fp);
+    cdump_syms(c, name, "syms", n, irep->slen, irep->syms, symtab, init_syms_code, fp);
   }
   /* dump iseq */
   len=irep->ilen+sizeof(struct mrc_irep_catch_handler)*irep->clen;
@@ -499,11 +527,11 @@ cdump_irep_struct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp
   fputs("};\n", fp);
   /* dump lv */
   if (irep->lv) {
-    cdump_syms(c, name, "lv", n, irep->nlocals-1, irep->lv, init_syms_code, fp);
+    cdump_syms(c, name, "lv", n, irep->nlocals-1, irep->lv, symtab, init_syms_code, fp);
   }
   /* dump debug */
   if (flags & MRC_DUMP_DEBUG_INFO) {
-    if (cdump_debug(c, name, n, irep->debug_info, init_syms_code, fp) == MRC_DUMP_OK) {
+    if (cdump_debug(c, name, n, irep->debug_info, symtab, init_syms_code, fp) == MRC_DUMP_OK) {
       debug_available = 1;
     }
   }
@@ -565,11 +593,20 @@ mrc_dump_irep_cstruct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE
   fputs("#define mrb_BRACED(...) {__VA_ARGS__}\n", fp);
   fputs("#define mrb_DEFINE_SYMS_VAR(name, len, syms, qualifier) \\\n", fp);
   fputs("  static qualifier mrb_sym name[len] = mrb_BRACED syms\n", fp);
+  fputs("#define mrb_FIXUP_SYMS(name, fixup, table) do { \\\n", fp);
+  fputs("  for (size_t i_ = 0; i_ < sizeof(fixup)/sizeof(fixup[0]); i_ += 2) \\\n", fp);
+  fputs("    (name)[(fixup)[i_]] = (table)[(fixup)[i_+1]]; \\\n", fp);
+  fputs("} while (0)\n", fp);
   fputs("\n", fp);
+  mrc_symtab symtab = { 0 };
   mrc_string *init_syms_code = mrc_str_new_capa(c, 1);
   int max = 1;
-  int n = cdump_irep_struct(c, irep, flags, fp, initname, 0, init_syms_code, &max);
-  if (n != MRC_DUMP_OK) return n;
+  int n = cdump_irep_struct(c, irep, flags, fp, initname, 0, &symtab, init_syms_code, &max);
+  if (n != MRC_DUMP_OK) {
+    mrc_symtab_free(c, &symtab);
+    mrc_str_free(c, init_syms_code);
+    return n;
+  }
   fprintf(fp,
           "%s\n"
           "const struct RProc %s[] = {{\n",
@@ -579,11 +616,32 @@ mrc_dump_irep_cstruct(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE
                                       "#endif",
           initname);
   fprintf(fp, "NULL,MRB_TT_PROC,MRB_GC_RED,MRB_OBJ_IS_FROZEN,0,{&%s_irep_0},NULL,{NULL},\n}};\n", initname);
+  if (0 < symtab.len) {
+    fprintf(fp, "static mrb_sym %s_symtab[%" PRIu32 "];\n", initname, symtab.len);
+    fprintf(fp, "static const struct { const char *name; size_t len; } %s_symtab_names[%" PRIu32 "] = {\n",
+            initname, symtab.len);
+    for (uint32_t i = 0; i < symtab.len; i++) {
+      const pm_constant_t *constant = pm_constant_pool_id_to_constant(&c->p->constant_pool, symtab.syms[i]);
+      mrc_string *name_obj = mrc_str_new(c, (const char *)constant->start, constant->length);
+      mrc_string *escaped = mrc_str_escape(c, name_obj);
+      fprintf(fp, "  {%s, %zu},\n", MRC_STRING_PTR(escaped), constant->length);
+      mrc_str_free(c, escaped);
+      mrc_str_free(c, name_obj);
+    }
+    fputs("};\n", fp);
+  }
   fputs("static void\n", fp);
   fprintf(fp, "%s_init_syms(mrb_state *mrb)\n", initname);
   fputs("{\n", fp);
+  if (0 < symtab.len) {
+    fprintf(fp, "  for (size_t i = 0; i < %" PRIu32 "; i++) {\n", symtab.len);
+    fprintf(fp, "    %s_symtab[i] = mrb_intern_static(mrb, %s_symtab_names[i].name, %s_symtab_names[i].len);\n",
+            initname, initname, initname);
+    fputs("  }\n", fp);
+  }
   fputs(MRC_STRING_PTR(init_syms_code), fp);
   fputs("}\n", fp);
+  mrc_symtab_free(c, &symtab);
   mrc_str_free(c, init_syms_code);
   return MRC_DUMP_OK;
 }
@@ -7,6 +7,8 @@
 #include "../include/mrc_pool.h"
 #include "../include/mrc_debug.h"
 #include "../include/mrc_irep_pool_type.h"
+#include "../include/mrc_codedump.h"
+#include "../include/mrc_json.h"
 #include <inttypes.h>
 
 const char *
@@ -88,13 +90,23 @@ print_lv_ab(mrc_ccontext *c, const mrc_irep *irep, uint16_t a, uint16_t b, FILE
   fprintf(out, "\n");
 }
 
+/* instructions are printed in pc order, so walk the line runs alongside */
+static int32_t
+iter_line(mrc_ccontext *c, mrc_debug_line_iter *it, uint32_t pc)
+{
+  while (pc >= it->end_pos) {
+    if (!mrc_debug_line_iter_next(c, it)) return -1;
+  }
+  return (pc >= it->start_pos) ? it->line : -1;
+}
+
 static void
-print_header(mrc_ccontext *c, const mrc_irep *irep, ptrdiff_t i, FILE *out)
+print_header(mrc_ccontext *c, mrc_debug_line_iter *it, ptrdiff_t i, FILE *out)
 {
   int32_t line;
 
   mrc_assert(i <= UINT32_MAX);
-  line = mrc_debug_get_line(c, irep, (uint32_t)i);
+  line = iter_line(c, it, (uint32_t)i);
   if (line < 0) {
     fprintf(out, "      ");
   }
@@ -138,6 +150,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
   const mrc_code *pc, *pcend;
   mrc_code ins;
   const char *file = NULL, *next_file;
+  mrc_debug_line_iter it;
 
   if (!irep) return;
   fprintf(out, "irep %p nregs=%d nlocals=%d pools=%d syms=%d reps=%d ilen=%d\n", (void*)irep,
@@ -185,6 +198,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
     }
   }
 
+  mrc_debug_line_iter_init(&it, irep);
   pc = irep->iseq;
   pcend = pc + irep->ilen;
   while (pc < pcend) {
@@ -201,7 +215,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
       fprintf(out, "file: %s\n", next_file);
       file = next_file;
     }
-    print_header(c, irep, i, out);
+    print_header(c, &it, i, out);
     ins = READ_B();
     switch (ins) {
     CASE(OP_NOP, Z):
@@ -667,7 +681,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
 
     CASE(OP_EXT1, Z):
       fprintf(out, "EXT1\n");
-      print_header(c, irep, pc-irep->iseq, out);
+      print_header(c, &it, pc-irep->iseq, out);
       ins = READ_B();
       switch (ins) {
 #define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _1 (); goto L_OP_ ## i;
@@ -677,7 +691,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
       break;
     CASE(OP_EXT2, Z):
       fprintf(out, "EXT2\n");
-      print_header(c, irep, pc-irep->iseq, out);
+      print_header(c, &it, pc-irep->iseq, out);
       ins = READ_B();
       switch (ins) {
 #define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _2 (); goto L_OP_ ## i;
@@ -687,7 +701,7 @@ codedump(mrc_ccontext *c, const mrc_irep *irep, FILE *out)
       break;
     CASE(OP_EXT3, Z):
       fprintf(out, "EXT3\n");
-      print_header(c, irep, pc-irep->iseq, out);
+      print_header(c, &it, pc-irep->iseq, out);
       ins = READ_B();
       switch (ins) {
 #define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _3 (); goto L_OP_ ## i;
@@ -734,3 +748,202 @@ mrc_codedump_all(mrc_ccontext *c, mrc_irep *irep)
   mrc_codedump_all_file(c, irep, stdout);
 #endif
 }
+
+static mrc_bool
+codestats_send(mrc_ccontext *c, mrc_codestats *st, mrc_sym sym)
+{
+  uint32_t capa = st->sends.capa;
+  uint32_t i = mrc_symtab_add(c, &st->sends, sym, NULL);
+
+  if (st->sends.capa != capa) {
+    uint32_t *counts = (uint32_t *)mrc_realloc(c, st->send_counts, sizeof(uint32_t) * st->sends.capa);
+    if (counts == NULL) return FALSE;
+    memset(counts + capa, 0, sizeof(uint32_t) * (st->sends.capa - capa));
+    st->send_counts = counts;
+  }
+  st->send_counts[i]++;
+  return TRUE;
+}
+
+static mrc_bool
+codestats_irep(mrc_ccontext *c, mrc_codestats *st, const mrc_irep *irep)
+{
+  const mrc_code *pc = irep->iseq;
+  const mrc_code *pcend = pc + irep->ilen;
+  int prev = -1;
+
+  st->ireps++;
+  st->iseq_bytes += irep->ilen;
+  st->nregs[irep->nregs < MRC_CODESTATS_REGS_MAX ? irep->nregs : MRC_CODESTATS_REGS_MAX - 1]++;
+  st->nlocals[irep->nlocals < MRC_CODESTATS_REGS_MAX ? irep->nlocals : MRC_CODESTATS_REGS_MAX - 1]++;
+  for (int i = 0; i < irep->plen; i++) {
+    uint32_t tt = irep->pool[i].tt;
+    st->pool[(tt & IREP_TT_NFLAG) ? (tt & 7) : (tt & 3)]++;
+  }
+
+  while (pc < pcend) {
+    mrc_code ins = READ_B();
+    int ext = 0;
+    uint32_t a = 0;
+    uint16_t b = 0;
+    uint16_t cc = 0;
+
+    if (OP_EXT1 <= ins && ins <= OP_EXT3) {
+      ext = ins - OP_EXT1 + 1;
+      st->ext[ext - 1]++;
+      ins = READ_B();
+    }
+    if (ins >= MRC_CODESTATS_NOPS) break;   /* not an instruction */
+    if (ext) st->ext_ops[ins]++;
+    switch (ext) {
+    case 0:
+      switch (ins) {
+#define OPCODE(i,x) case OP_ ## i: FETCH_ ## x (); break;
+#include "mrc_ops.h"
+#undef OPCODE
+      }
+      break;
+    case 1:
+      switch (ins) {
+#define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _1 (); break;
+#include "mrc_ops.h"
+#undef OPCODE
+      }
+      break;
+    case 2:
+      switch (ins) {
+#define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _2 (); break;
+#include "mrc_ops.h"
+#undef OPCODE
+      }
+      break;
+    default:
+      switch (ins) {
+#define OPCODE(i,x) case OP_ ## i: FETCH_ ## x ## _3 (); break;
+#include "mrc_ops.h"
+#undef OPCODE
+      }
+      break;
+    }
+    (void)a; (void)cc;
+
+    st->insns++;
+    st->ops[ins]++;
+    if (prev >= 0) st->pairs[prev][ins]++;
+    prev = ins;
+
+    switch (ins) {
+    case OP_SEND: case OP_SEND0: case OP_SENDB:
+    case OP_SSEND: case OP_SSEND0: case OP_SSENDB:
+      if (b < irep->slen && !codestats_send(c, st, irep->syms[b])) return FALSE;
+      break;
+    default:
+      break;
+    }
+  }
+
+  for (int i = 0; i < irep->rlen; i++) {
+    if (!codestats_irep(c, st, irep->reps[i])) return FALSE;
+  }
+  return TRUE;
+}
+
+mrc_codestats*
+mrc_codestats_new(mrc_ccontext *c, const mrc_irep *irep)
+{
+  mrc_codestats *st = (mrc_codestats *)mrc_calloc(c, 1, sizeof(mrc_codestats));
+
+  if (st == NULL) return NULL;
+  if (irep && !codestats_irep(c, st, irep)) {
+    mrc_codestats_free(c, st);
+    return NULL;
+  }
+  return st;
+}
+
+void
+mrc_codestats_free(mrc_ccontext *c, mrc_codestats *st)
+{
+  if (st == NULL) return;
+  mrc_symtab_free(c, &st->sends);
+  mrc_free(c, st->send_counts);
+  mrc_free(c, st);
+}
+
+#ifndef MRC_NO_STDIO
+static const char *const codestats_op_names[] = {
+#define OPCODE(x,_) #x,
+#include "mrc_ops.h"
+#undef OPCODE
+};
+
+/* {"NAME":n,...} over the nonzero entries of an array indexed by opcode */
+static void
+json_ops(const uint32_t *counts, FILE *out)
+{
+  const char *sep = "";
+
+  fputc('{', out);
+  for (int i = 0; i < MRC_CODESTATS_NOPS; i++) {
+    if (counts[i] == 0) continue;
+    fprintf(out, "%s\"%s\":%" PRIu32, sep, codestats_op_names[i], counts[i]);
+    sep = ",";
+  }
+  fputc('}', out);
+}
+
+static void
+json_buckets(const uint32_t *counts, int n, FILE *out)
+{
+  const char *sep = "";
+
+  fputc('{', out);
+  for (int i = 0; i < n; i++) {
+    if (counts[i] == 0) continue;
+    fprintf(out, "%s\"%d\":%" PRIu32, sep, i, counts[i]);
+    sep = ",";
+  }
+  fputc('}', out);
+}
+
+void
+mrc_codestats_dump_json(mrc_ccontext *c, const mrc_codestats *st, FILE *out)
+{
+  const char *sep = "";
+
+  fprintf(out, "{\"ireps\":%" PRIu32 ",\"insns\":%" PRIu32 ",\"iseq_bytes\":%zu",
+          st->ireps, st->insns, st->iseq_bytes);
+  fprintf(out, ",\"ext\":[%" PRIu32 ",%" PRIu32 ",%" PRIu32 "]", st->ext[0], st->ext[1], st->ext[2]);
+  fputs(",\"ops\":", out);
+  json_ops(st->ops, out);
+  fputs(",\"ext_ops\":", out);
+  json_ops(st->ext_ops, out);
+  fputs(",\"pairs\":{", out);
+  for (int i = 0; i < MRC_CODESTATS_NOPS; i++) {
+    for (int j = 0; j < MRC_CODESTATS_NOPS; j++) {
+      if (st->pairs[i][j] == 0) continue;
+      fprintf(out, "%s\"%s %s\":%" PRIu32, sep, codestats_op_names[i], codestats_op_names[j], st->pairs[i][j]);
+      sep = ",";
+    }
+  }
+  fputs("},\"nregs\":", out);
+  json_buckets(st->nregs, MRC_CODESTATS_REGS_MAX, out);
+  fputs(",\"nlocals\":", out);
+  json_buckets(st->nlocals, MRC_CODESTATS_REGS_MAX, out);
+  fprintf(out, ",\"pool\":{\"str\":%" PRIu32 ",\"sstr\":%" PRIu32 ",\"int32\":%" PRIu32
+          ",\"int64\":%" PRIu32 ",\"float\":%" PRIu32 ",\"bigint\":%" PRIu32 "}",
+          st->pool[IREP_TT_STR], st->pool[IREP_TT_SSTR], st->pool[IREP_TT_INT32],
+          st->pool[IREP_TT_INT64], st->pool[IREP_TT_FLOAT], st->pool[IREP_TT_BIGINT]);
+  fputs(",\"sends\":{", out);
+  sep = "";
+  for (uint32_t i = 0; i < st->sends.len; i++) {
+    mrc_int len = 0;
+    const char *name = mrc_sym_name_len(c, st->sends.syms[i], &len);
+    fputs(sep, out);
+    mrc_json_string(name ? name : "", name ? (size_t)len : 0, out);
+    fprintf(out, ":%" PRIu32, st->send_counts[i]);
+    sep = ",";
+  }
+  fputs("}}\n", out);
+}
+#endif // MRC_NO_STDIO
@@ -9,6 +9,8 @@
 #include "../include/mrc_pool.h"
 #include "../include/mrc_dump.h"
 #include "../include/mrc_debug.h"
+#include "../include/mrc_position.h"
+#include "../include/mrc_trace.h"
 #include "../include/mrc_irep_pool_type.h"
 
 #if defined(MRC_TARGET_MRUBY)
@@ -222,11 +224,13 @@ typedef struct scope {
 
   struct loopinfo *loop;
   const char *filename;
-  uint16_t lineno;
+  uint32_t lineno;
 
   mrc_code *iseq;
-  uint16_t *lines;
   uint32_t icapa;
+  /* (pc, line) at each line change of the iseq; only kept with a filename */
+  mrc_irep_debug_line_run *lines;
+  uint32_t lines_len, lines_capa;
 
   mrc_irep *irep;
   mrc_pool_value *pool;
@@ -245,6 +249,7 @@ typedef struct scope {
 
   int rlev;                     /* recursion levels */
   uint16_t for_depth;           /* number of for-loop scopes above */
+  uint32_t regexp_count;        /* cached regexp literals; root scope only */
 } mrc_codegen_scope;
 
 static void codegen(mrc_codegen_scope *s, mrc_node *tree, int val);
@@ -261,7 +266,7 @@ codegen_error(mrc_codegen_scope *s, const char *message)
   if (!s->c->quiet_errors) {
     if (s->filename && s->lineno) {
       const char *filename = (const char *)s->filename;
-      fprintf(stderr, "%s:%d: %s\n", filename, s->lineno, message);
+      fprintf(stderr, "%s:%u: %s\n", filename, (unsigned)s->lineno, message);
     }
     else {
       fprintf(stderr, "%s\n", message);
@@ -291,6 +296,10 @@ codegen_error(mrc_codegen_scope *s, const char *message)
         mrc_free(s->c, s->reps);
       }
       mrc_free(s->c, s->lines);
+      mrc_trace_end_irep(s->c, "scope", s->pc, s->irep->plen, s->irep->slen);
+    }
+    else {
+      mrc_trace_end(s->c, "scope");
     }
     mrc_pool_close(s->mpool);
     s = tmp;
@@ -330,6 +339,27 @@ new_label(mrc_codegen_scope *s)
   return s->lastlabel = s->pc;
 }
 
+static void
+record_line(mrc_codegen_scope *s, uint32_t pc)
+{
+  int32_t prev;
+
+  /* code from `pc` on may have been rewound by the peephole optimizer */
+  while (s->lines_len > 0 && s->lines[s->lines_len-1].start_pos >= pc) {
+    s->lines_len--;
+  }
+  prev = s->lines_len > 0 ? s->lines[s->lines_len-1].line : 0;
+  if (s->lineno == 0 || (int32_t)s->lineno == prev) return;
+
+  if (s->lines_len == s->lines_capa) {
+    s->lines_capa *= 2;
+    s->lines = (mrc_irep_debug_line_run*)mrc_realloc(s->c, s->lines, sizeof(mrc_irep_debug_line_run)*s->lines_capa);
+  }
+  s->lines[s->lines_len].start_pos = pc;
+  s->lines[s->lines_len].line = (int32_t)s->lineno;
+  s->lines_len++;
+}
+
 static void
 emit_B(mrc_codegen_scope *s, uint32_t pc, uint8_t i)
 {
@@ -344,15 +374,10 @@ emit_B(mrc_codegen_scope *s, uint32_t pc, uint8_t i)
       s->icapa *= 2;
     }
     s->iseq = (mrc_code*)mrc_realloc(s->c, s->iseq, sizeof(mrc_code)*s->icapa);
-    if (s->lines) {
-      s->lines = (uint16_t*)mrc_realloc(s->c, s->lines, sizeof(uint16_t)*s->icapa);
-    }
   }
-  if (s->lines) {
-    if (s->lineno > 0 || pc == 0)
-      s->lines[pc] = s->lineno;
-    else
-      s->lines[pc] = s->lines[pc-1];
+  /* bytes patched behind s->pc keep the line they were emitted on */
+  if (s->lines && pc >= s->pc) {
+    record_line(s, pc);
   }
   s->iseq[pc] = i;
 }
@@ -599,8 +624,10 @@ scope_new(mrc_ccontext *c, mrc_codegen_scope *prev, mrc_constant_id_list *nlv)
   int ai = mrc_gc_arena_save(c);
   s->ai = ai;
   s->filename = prev->filename;
+  s->lines_len = 0;
   if (s->filename) {
-    s->lines = (uint16_t *)mrc_malloc(c, sizeof(uint16_t)*s->icapa);
+    s->lines_capa = 64;
+    s->lines = (mrc_irep_debug_line_run *)mrc_malloc(c, sizeof(mrc_irep_debug_line_run)*s->lines_capa);
   }
   s->lineno = prev->lineno;
 
@@ -615,6 +642,7 @@ scope_new(mrc_ccontext *c, mrc_codegen_scope *prev, mrc_constant_id_list *nlv)
   s->c = prev->c;
   s->filename_index = prev->filename_index;
   s->rlev = prev->rlev + 1;
+  mrc_trace_begin(c, "scope", s->filename, s->lineno);
   return s;
 }
 
@@ -737,6 +765,22 @@ static uint8_t mrc_insn_size3[] = {
 #undef BSS
 #undef OPCODE
 
+/* bytes of the instruction at `i`, an OP_EXTn prefix included */
+static uint32_t
+insn_length(const mrc_code *i)
+{
+  switch (i[0]) {
+  case OP_EXT1:
+    return mrc_insn_size1[i[1]] + 1;
+  case OP_EXT2:
+    return mrc_insn_size2[i[1]] + 1;
+  case OP_EXT3:
+    return mrc_insn_size3[i[1]] + 1;
+  default:
+    return mrc_insn_size[i[0]];
+  }
+}
+
 static const mrc_code*
 mrc_prev_pc(mrc_codegen_scope *s, const mrc_code *pc)
 {
@@ -744,22 +788,8 @@ mrc_prev_pc(mrc_codegen_scope *s, const mrc_code *pc)
   const mrc_code *i = s->iseq;
 
   while (i<pc) {
-    uint8_t insn = i[0];
     prev_pc = i;
-    switch (insn) {
-    case OP_EXT1:
-      i += mrc_insn_size1[i[1]] + 1;
-      break;
-    case OP_EXT2:
-      i += mrc_insn_size2[i[1]] + 1;
-      break;
-    case OP_EXT3:
-      i += mrc_insn_size3[i[1]] + 1;
-      break;
-    default:
-      i += mrc_insn_size[insn];
-      break;
-    }
+    i += insn_length(i);
   }
   return prev_pc;
 }
@@ -1249,7 +1279,7 @@ scope_finish(mrc_codegen_scope *s)
   if (s->filename) {
     const char *filename = mrc_parser_get_filename(s->c, s->filename_index);
     mrc_debug_info_append_file(s->c, s->irep->debug_info,
-                               filename, s->lines, s->debug_start_pos, s->pc);
+                               filename, s->lines, s->lines_len, s->debug_start_pos, s->pc);
   }
   mrc_free(s->c, s->lines);
   irep->nlocals = s->nlocals;
@@ -1257,6 +1287,7 @@ scope_finish(mrc_codegen_scope *s)
 
   mrc_gc_arena_restore(s->c, s->ai);
   mrc_pool_close(s->mpool);
+  mrc_trace_end_irep(s->c, "scope", irep->ilen, irep->plen, irep->slen);
 }
 
 static mrc_pool_value*
@@ -1499,8 +1530,9 @@ gen_binop(mrc_codegen_scope *s, mrc_sym op, uint16_t dst)
 
 #define JMPLINK_START UINT32_MAX
 
+/* point the jump at pos0 to `pc`; return the next jump of its chain */
 static uint32_t
-dispatch(mrc_codegen_scope *s, uint32_t pos0)
+dispatch_to(mrc_codegen_scope *s, uint32_t pos0, uint32_t pc)
 {
   int32_t pos1;
   int32_t offset;
@@ -1509,17 +1541,24 @@ dispatch(mrc_codegen_scope *s, uint32_t pos0)
   if (pos0 == JMPLINK_START) return 0;
 
   pos1 = pos0 + 2;
-  offset = s->pc - pos1;
-  if (offset > INT16_MAX) {
+  offset = (int32_t)pc - pos1;
+  if (offset > INT16_MAX || INT16_MIN > offset) {
     codegen_error(s, "too big jmp offset");
   }
-  s->lastlabel = s->pc;
   newpos = (int16_t)PEEK_S(s->iseq+pos0);
   emit_S(s, pos0, (uint16_t)offset);
   if (newpos == 0) return 0;
   return pos1+newpos;
 }
 
+static uint32_t
+dispatch(mrc_codegen_scope *s, uint32_t pos0)
+{
+  if (pos0 == JMPLINK_START) return 0;
+  s->lastlabel = s->pc;
+  return dispatch_to(s, pos0, s->pc);
+}
+
 static void
 dispatch_linked(mrc_codegen_scope *s, uint32_t pos)
 {
@@ -1530,6 +1569,17 @@ dispatch_linked(mrc_codegen_scope *s, uint32_t pos)
   }
 }
 
+/* same for a label already emitted, e.g. the head of a loop */
+static void
+dispatch_linked_to(mrc_codegen_scope *s, uint32_t pos, uint32_t pc)
+{
+  if (pos==JMPLINK_START) return;
+  for (;;) {
+    pos = dispatch_to(s, pos, pc);
+    if (pos==0) break;
+  }
+}
+
 static int
 new_litbint(mrc_codegen_scope *s, const char *p, int base, mrc_bool neg)
 {
@@ -1822,10 +1872,49 @@ generate_code(mrc_ccontext *c, mrc_node *node, int val)
   MRC_END_EXC(c->jmp);
 }
 
+static void
+stats_count_irep(mrc_stats *st, const mrc_irep *irep)
+{
+  const mrc_code *i = irep->iseq;
+  const mrc_code *end = i + irep->ilen;
+
+  st->ireps++;
+  st->pool_entries += irep->plen;
+  st->syms += irep->slen;
+  st->nregs += irep->nregs;
+  st->iseq_bytes += irep->ilen;
+  while (i < end) {
+    st->insns++;
+    if (i[0] == OP_EXT1 || i[0] == OP_EXT2 || i[0] == OP_EXT3) st->ext_ops++;
+    i += insn_length(i);
+  }
+  for (int n = 0; n < irep->rlen; n++) {
+    stats_count_irep(st, irep->reps[n]);
+  }
+}
+
 MRC_API mrc_irep *
 mrc_generate_code(mrc_ccontext *c, mrc_node *node)
 {
-  return generate_code(c, node, VAL);
+  if (!c->stats && !c->trace) return generate_code(c, node, VAL);
+
+  mrc_trace_begin(c, "codegen", NULL, 0);
+  uint64_t start = c->stats ? mrc_stats_clock() : 0;
+  uint64_t allocs, alloc_bytes, allocs1, alloc_bytes1, live, live1, peak;
+  mrc_stats_allocs(&allocs, &alloc_bytes);
+  mrc_stats_live(&live, &peak);
+  mrc_irep *irep = generate_code(c, node, VAL);
+  if (c->stats) {
+    c->stats->codegen_ns += mrc_stats_clock() - start;
+    mrc_stats_allocs(&allocs1, &alloc_bytes1);
+    c->stats->codegen_allocs += allocs1 - allocs;
+    c->stats->codegen_alloc_bytes += alloc_bytes1 - alloc_bytes;
+    mrc_stats_live(&live1, &peak);
+    if (peak - live > c->stats->codegen_peak_bytes) c->stats->codegen_peak_bytes = peak - live;
+    if (irep) stats_count_irep(c->stats, irep);
+  }
+  mrc_trace_end(c, "codegen");
+  return irep;
 }
 
 #define CALL_MAXARGS 15
@@ -1871,21 +1960,11 @@ nsym(mrc_parser_state *p, const uint8_t *start, size_t length)
 static int32_t
 node_lineno(mrc_ccontext *c, mrc_node *node)
 {
-  pm_location_t *loc = &((pm_node_t *)node)->location;
-  int32_t abs_line = pm_newline_list_line(&c->p->newline_list, loc->start, 1);
+  mrc_position pos;
   int32_t line_offset = c->lineno > 0 ? c->lineno - 1 : 0;
-  uint32_t node_pos = (uint32_t)(loc->start - c->p->start);
-  uint32_t file_start = 0;
-  for (uint16_t i = 1; i < c->filename_table_length; i++) {
-    if (c->filename_table[i].start <= node_pos) {
-      file_start = c->filename_table[i].start;
-    } else {
-      break;
-    }
-  }
-  if (file_start == 0) return abs_line + line_offset;
-  int32_t file_start_line = pm_newline_list_line(&c->p->newline_list, c->p->start + file_start, 1);
-  return abs_line - file_start_line + 1 + line_offset;
+
+  if (!mrc_position_resolve(c, ((pm_node_t *)node)->location.start, &pos)) return 0;
+  return (int32_t)pos.line + line_offset;
 }
 
 /* `alias` and `undef` take compile-time symbol indices, but prism hands them a
@@ -1942,6 +2021,95 @@ false_always(mrc_node *tree)
   }
 }
 
+/* Branch on a condition without materializing its value: emit code that
+   jumps when `cond` is truthy (`jump_if` TRUE) or falsy (FALSE) and falls
+   through otherwise. The jumps are linked onto `chain` and the new head is
+   returned, for dispatch_linked() or dispatch_linked_to(). `&&`, `||` and
+   parentheses become jumps between the operands; `nil?` tests with JMPNIL
+   like `if` always did. `!` and comparisons are still sent, so redefining
+   them keeps working. */
+static uint32_t
+gen_branch(mrc_codegen_scope *s, mrc_node *cond, mrc_bool jump_if, uint32_t chain)
+{
+  uint32_t pos, skip;
+
+  if (true_always(cond) || false_always(cond)) {
+    if (true_always(cond) == jump_if) {
+      chain = genjmp(s, OP_JMP, chain);
+    }
+    return chain;
+  }
+  switch (nint(cond)) {
+  case PM_AND_NODE:
+  case PM_OR_NODE:
+  {
+    mrc_node *left, *right;
+    mrc_bool and_p = nint(cond) == PM_AND_NODE;
+
+    if (and_p) {
+      left = ((pm_and_node_t *)cond)->left;
+      right = ((pm_and_node_t *)cond)->right;
+    }
+    else {
+      left = ((pm_or_node_t *)cond)->left;
+      right = ((pm_or_node_t *)cond)->right;
+    }
+    if (and_p != jump_if) {
+      /* `a && b` is falsy if either is, `a || b` truthy if either is */
+      chain = gen_branch(s, left, jump_if, chain);
+      return gen_branch(s, right, jump_if, chain);
+    }
+    /* otherwise the left operand alone decides only the other way */
+    skip = gen_branch(s, left, !jump_if, JMPLINK_START);
+    chain = gen_branch(s, right, jump_if, chain);
+    dispatch_linked(s, skip);
+    return chain;
+  }
+  case PM_PARENTHESES_NODE:
+  {
+    pm_node_t *body = ((pm_parentheses_node_t *)cond)->body;
+
+    if (body && PM_NODE_TYPE(body) == PM_STATEMENTS_NODE &&
+        ((pm_statements_node_t *)body)->body.size == 1) {
+      return gen_branch(s, ((pm_statements_node_t *)body)->body.nodes[0], jump_if, chain);
+    }
+    break;
+  }
+  case PM_CALL_NODE:
+  {
+    pm_call_node_t *n = (pm_call_node_t *)cond;
+
+    /* `a&.nil?` is nil for a nil `a`, and a block may change the answer */
+    if (n->name != MRC_SYM_2(nil_p) || n->arguments != NULL || n->block != NULL ||
+        (n->base.flags & PM_CALL_NODE_FLAGS_SAFE_NAVIGATION)) break;
+    if (n->receiver) {
+      codegen(s, (mrc_node *)n->receiver, VAL);
+    }
+    else {
+      /* implicit receiver: bare `nil?` means `self.nil?` (#6874) */
+      genop_1(s, OP_LOADSELF, cursp());
+      push();
+    }
+    pop();
+    if (jump_if) {
+      pos = genjmp2(s, OP_JMPNIL, cursp(), chain, NOVAL);
+      return pos == JMPLINK_START ? chain : pos;
+    }
+    skip = genjmp2_0(s, OP_JMPNIL, cursp(), NOVAL);
+    chain = genjmp(s, OP_JMP, chain);
+    dispatch(s, skip);
+    return chain;
+  }
+  default:
+    break;
+  }
+  codegen(s, cond, VAL);
+  pop();
+  pos = genjmp2(s, jump_if ? OP_JMPIF : OP_JMPNOT, cursp(), chain, NOVAL);
+  /* no jump if the peephole found the value constant */
+  return pos == JMPLINK_START ? chain : pos;
+}
+
 static void
 gen_retval(mrc_codegen_scope *s, mrc_node *tree)
 {
@@ -3855,6 +4023,36 @@ lambda_body(mrc_codegen_scope *s, mrc_node *tree, mrc_node *body, pm_constant_id
   return parent->irep->rlen - 1;
 }
 
+/* `&:sym` as `->(x, *a, &b) { x.sym(*a, &b) }`. A lambda, so a yielded array
+   is the receiver rather than being splatted, as with Symbol#to_proc; but a
+   redefined Symbol#to_proc is not called. */
+static int
+sym_proc_body(mrc_codegen_scope *s, mrc_sym sym)
+{
+  mrc_codegen_scope *parent = s;
+  pm_constant_id_list_t *lv = (pm_constant_id_list_t *)codegen_palloc(s, sizeof(pm_constant_id_list_t));
+  pm_constant_id_t null_mark = pm_constant_pool_insert_constant(&s->c->p->constant_pool, (const uint8_t *)"", 0);
+
+  /* R1 receiver, R2 rest; ENTER leaves the block in R3 */
+  mrc_constant_id_list_init_capacity(s, lv, 3);
+  mrc_constant_id_list_append(s, lv, null_mark);
+  mrc_constant_id_list_append(s, lv, MRC_OPSYM_2(mul));
+  mrc_constant_id_list_append(s, lv, MRC_OPSYM_2(and));
+
+  s = scope_new(s->c, s, lv);
+  genop_W(s, OP_ENTER, MRC_ARGS_REQ(1) | MRC_ARGS_REST() | MRC_ARGS_BLOCK());
+  s->ainfo = (1 << 7) | (1 << 6);
+  for (uint16_t i = 1; i <= 3; i++) {
+    genop_2(s, OP_MOVE, cursp(), i);
+    push();
+  }
+  pop_n(3);
+  genop_3(s, OP_SENDB, cursp(), new_sym(s, sym), CALL_MAXARGS);
+  gen_return(s, OP_RETURN, cursp());
+  scope_finish(s);
+  return parent->irep->rlen - 1;
+}
+
 static void
 gen_lvar(mrc_codegen_scope *s, mrc_sym name, int depth)
 {
@@ -3946,6 +4144,51 @@ regex_set_flags(pm_node_flags_t flags, char *p2, char *p3)
   // PM_REGULAR_EXPRESSION_FLAGS_FORCED_US_ASCII_ENCODING
 }
 
+/* Longest pattern whose compiled Regexp is cached; the cache key repeats
+   the pattern in the symbol table, so keep that bounded. */
+#define REGEXP_CACHE_MAX 256
+
+/* The global a literal regexp is kept in after its first evaluation, or -1
+   to compile it every time. The name holds the literal's number in this
+   compile, its flags and its pattern, so it is the same every time the
+   source is compiled and no two literals of one program share a Regexp.
+   Literals of other programs get the same name only when they are the same
+   literal at the same place, so they share an equal Regexp. The cache is a
+   real global and shows up in `global_variables`, though it cannot be
+   spelled in Ruby. Each program adds one per cached literal, so a host
+   that compiles ever new code (an eval loop) keeps accumulating them. */
+static int
+regexp_cache_sym(mrc_codegen_scope *s, const char *pat, size_t len, const char *p2, const char *p3)
+{
+  static const char prefix[] = "$(regexp)";
+  size_t plen = sizeof(prefix) - 1;
+  mrc_codegen_scope *root = s;
+  char digits[10];
+  size_t ndigits = 0;
+  size_t n = 0;
+  char *name;
+  mrc_sym sym;
+
+  if (no_optimize(s) || len > REGEXP_CACHE_MAX) return -1;
+  while (root->prev) root = root->prev;
+  for (uint32_t k = root->regexp_count++; ndigits == 0 || k > 0; k /= 10) {
+    digits[ndigits++] = '0' + k % 10;
+  }
+  name = (char *)mrc_malloc(s->c, plen + ndigits + 1 + 4 + 1 + 1 + len);
+  memcpy(name, prefix, plen);
+  n = plen;
+  while (ndigits > 0) name[n++] = digits[--ndigits];
+  name[n++] = ':';
+  while (*p2) name[n++] = *p2++;
+  if (p3[0]) name[n++] = p3[0];
+  name[n++] = '/';
+  if (len) memcpy(name + n, pat, len);
+  n += len;
+  sym = nsym(s->c->p, (const uint8_t *)name, n);
+  mrc_free(s->c, name);
+  return new_sym(s, sym);
+}
+
 static void
 gen_begin(mrc_codegen_scope *s, mrc_node *tree, int val)
 {
@@ -4112,7 +4355,7 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
   if (s->filename_index+1 < s->c->filename_table_length) {
     if (s->c->filename_table[s->filename_index+1].start <= token_pos) {
       mrc_debug_info_append_file(s->c, s->irep->debug_info,
-                                s->filename, s->lines, s->debug_start_pos, s->pc);
+                                s->filename, s->lines, s->lines_len, s->debug_start_pos, s->pc);
       s->debug_start_pos = s->pc;
       s->filename_index++;
       s->filename = (const char *)s->c->filename_table[s->filename_index].filename;
@@ -4848,10 +5091,17 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         char p2[4] = {0, 0, 0, 0};
         char p3[2] = {0, 0};
         regex_set_flags(cast->base.flags, p2, p3);
+        int cache = regexp_cache_sym(s, p1, cast->unescaped.length, p2, p3);
         int sym = new_sym(s, MRC_SYM_1(Regexp));
         int off = new_lit_str(s, p1, cast->unescaped.length);
         int argc = 1;
+        uint32_t cached = JMPLINK_START;
 
+        if (cache >= 0) {
+          /* GETGV R cache; JMPIF R done; <compile>; SETGV R cache; done: */
+          genop_2(s, OP_GETGV, cursp(), cache);
+          cached = genjmp2_0(s, OP_JMPIF, cursp(), VAL);
+        }
         genop_1(s, OP_OCLASS, cursp());
         genop_2(s, OP_GETMCNST, cursp(), sym);
         push();
@@ -4878,6 +5128,10 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         pop_n(argc+2);
         sym = new_sym(s, MRC_SYM_1(compile));
         genop_3(s, OP_SEND, cursp(), sym, argc);
+        if (cache >= 0) {
+          genop_2(s, OP_SETGV, cursp(), cache);
+          dispatch(s, cached);
+        }
         push();
       }
       break;
@@ -5193,7 +5447,6 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         statements = (mrc_node *)cast->else_clause; /* opposite */
       }
       uint32_t pos1, pos2;
-      mrc_bool nil_p = FALSE;
 
       if (!predicate) {
         codegen(s, subsequent, val);
@@ -5207,61 +5460,29 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         codegen(s, subsequent, val);
         goto exit;
       }
-      if (nint(predicate) == PM_CALL_NODE) {
-        pm_call_node_t *n = (pm_call_node_t *)predicate;
-        mrc_sym mid = n->name;
-        mrc_sym sym_nil_p = MRC_SYM_2(nil_p);
-        if (mid == sym_nil_p && n->arguments == NULL) {
-          nil_p = TRUE;
-          if (n->receiver) {
-            codegen(s, (mrc_node *)n->receiver, VAL);
-          }
-          else {
-            /* implicit receiver: bare `nil?` means `self.nil?` (#6874) */
-            genop_1(s, OP_LOADSELF, cursp());
-            push();
-          }
-        }
-      }
-      if (!nil_p) {
-        codegen(s, predicate, VAL);
-      }
-      pop();
       if (val || statements) {
-        if (nil_p) {
-          pos2 = genjmp2_0(s, OP_JMPNIL, cursp(), val);
-          pos1 = genjmp_0(s, OP_JMP);
-          dispatch(s, pos2);
-        }
-        else {
-          pos1 = genjmp2_0(s, OP_JMPNOT, cursp(), val);
-        }
+        pos1 = gen_branch(s, predicate, FALSE, JMPLINK_START);
         codegen(s, statements, val);
         if (val) pop();
         if (subsequent || val) {
           pos2 = genjmp_0(s, OP_JMP);
-          dispatch(s, pos1);
+          dispatch_linked(s, pos1);
           codegen(s, subsequent, val);
           dispatch(s, pos2);
         }
         else {
-          dispatch(s, pos1);
+          dispatch_linked(s, pos1);
         }
       }
       else {                   /* empty then-part */
         if (subsequent) {
-          if (nil_p) {
-            pos1 = genjmp2_0(s, OP_JMPNIL, cursp(), val);
-          }
-          else {
-            pos1 = genjmp2_0(s, OP_JMPIF, cursp(), val);
-          }
+          pos1 = gen_branch(s, predicate, TRUE, JMPLINK_START);
           codegen(s, subsequent, val);
-          dispatch(s, pos1);
+          dispatch_linked(s, pos1);
         }
-        else if (val && !nil_p) {
-          genop_1(s, OP_LOADNIL, cursp());
-          push();
+        else {
+          codegen(s, predicate, VAL);
+          pop();
         }
       }
       break;
@@ -5344,19 +5565,18 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
           loop_pop(s, val);
           break;
         }
+        /* same layout as the loop below, entered at the body */
         struct loopinfo *lp = loop_push(s, LOOP_NORMAL);
         if (!val) lp->reg = -1;
         uint32_t pos0 = genjmp_0(s, OP_JMP);
         lp->pc0 = new_label(s);
-        codegen(s, cast->predicate, VAL);
-        pop();
-        uint32_t pos = genjmp2_0(s, is_until ? OP_JMPIF : OP_JMPNOT, cursp(), NOVAL);
+        uint32_t pos = genjmp_0(s, OP_JMP);
+        dispatch(s, pos0);
         lp->pc1 = new_label(s);
         genop_0(s, OP_NOP); /* for redo */
-        dispatch(s, pos0);
         codegen(s, (mrc_node *)cast->statements, NOVAL);
-        genjmp(s, OP_JMP, lp->pc0);
         dispatch(s, pos);
+        dispatch_linked_to(s, gen_branch(s, cast->predicate, !is_until, JMPLINK_START), lp->pc1);
         loop_pop(s, val);
         break;
       }
@@ -5379,24 +5599,25 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         }
       }
 
-      uint32_t pos = JMPLINK_START;
+      /* The condition is placed after the body, so an iteration takes one
+         branch instead of a test at the top plus a jump back to it:
+
+           pc0: JMP cond      (entry; `next` comes here too)
+           pc1: NOP           (redo)
+                <body>
+           cond: <predicate>
+                JMPIF/JMPNOT pc1
+       */
       struct loopinfo *lp = loop_push(s, LOOP_NORMAL);
 
       if (!val) lp->reg = -1;
       lp->pc0 = new_label(s);
-      codegen(s, cast->predicate, VAL);
-      pop();
-      if (nt == PM_WHILE_NODE) {
-        pos = genjmp2_0(s, OP_JMPNOT, cursp(), NOVAL);
-      }
-      else {
-        pos = genjmp2_0(s, OP_JMPIF, cursp(), NOVAL);
-      }
+      uint32_t pos = genjmp_0(s, OP_JMP);
       lp->pc1 = new_label(s);
       genop_0(s, OP_NOP); /* for redo */
       codegen(s, (mrc_node *)cast->statements, NOVAL);
-      genjmp(s, OP_JMP, lp->pc0);
       dispatch(s, pos);
+      dispatch_linked_to(s, gen_branch(s, cast->predicate, nt == PM_WHILE_NODE, JMPLINK_START), lp->pc1);
       loop_pop(s, val);
       break;
     }
@@ -6143,6 +6364,12 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
         }
         if (val) push();
       }
+      else if (val && s->c->sym_proc && nint(cast->expression) == PM_SYMBOL_NODE) {
+        CAST3(symbol, cast->expression, sym);
+        mrc_sym name = nsym(s->c->p, sym->unescaped.source, sym->unescaped.length);
+        genop_2(s, OP_LAMBDA, cursp(), sym_proc_body(s, name));
+        push();
+      }
       else {
         codegen(s, cast->expression, val);
       }
@@ -6176,8 +6403,18 @@ codegen(mrc_codegen_scope *s, mrc_node *tree, int val)
     {
       if (val) {
         CAST(source_file);
-        char *p = (char *)cast->filepath.source;
+        const char *p = (const char *)cast->filepath.source;
         mrc_int len = cast->filepath.length;
+#ifndef MRC_NO_STDIO
+        /* the parser only knows the first file's name; find the file the
+           node is in from its offset */
+        mrc_position pos;
+        if (1 < s->c->filename_table_length &&
+            mrc_position_resolve(s->c, tree->location.start, &pos)) {
+          p = s->c->filename_table[pos.file].filename;
+          len = (mrc_int)strlen(p);
+        }
+#endif
         int off = new_lit_str(s, p, len);
         genop_2(s, OP_STRING, cursp(), off);
         push();
@@ -7,6 +7,7 @@
 #include "../include/mrc_opcode.h"
 #include "../include/mrc_presym.h"
 #include "../include/mrc_diagnostic.h"
+#include "../include/mrc_trace.h"
 
 #if defined(MRC_TARGET_MRUBY)
 #include "../include/mrc_proc.h"
@@ -55,28 +56,6 @@ mrc_load_exec(mrc_ccontext *c, mrc_node *ast)
   return irep;
 }
 
-static void
-partial_hook(void *data, pm_parser_t *p, pm_token_t *token)
-{
-  mrc_ccontext *c = (mrc_ccontext *)data;
-  if (c->current_filename_index + 1 == c->filename_table_length) {
-    return;
-  }
-  uint32_t token_pos = (uint32_t)(token->start - p->start);
-  if (token_pos < c->filename_table[c->current_filename_index].start) {
-    return;
-  }
-  if (c->filename_table[c->current_filename_index + 1].start <= token_pos) {
-    c->current_filename_index++;
-    pm_string_t filename_string;
-    pm_string_constant_init(
-        &filename_string,
-        c->filename_table[c->current_filename_index].filename,
-        strlen(c->filename_table[c->current_filename_index].filename));
-    p->filepath = filename_string;
-  }
-}
-
 #if defined(MRC_TARGET_MRUBY)
 #define MRC_PROC_CFUNC_FL 128
 #define MRC_PROC_CFUNC_P(p) (((p)->flags & MRC_PROC_CFUNC_FL) != 0)
@@ -177,14 +156,10 @@ mrc_pm_options_init(mrc_ccontext *cc)
 static void
 mrc_pm_parser_init(mrc_parser_state *p, uint8_t **source, size_t size, mrc_ccontext *cc)
 {
-  pm_lex_callback_t *cb = (pm_lex_callback_t *)mrc_malloc(cc, sizeof(pm_lex_callback_t));
-  cb->data = cc;
-  cb->callback = partial_hook;
 #if defined(MRC_TARGET_MRUBY)
   mrc_pm_options_init(cc);
 #endif
   pm_parser_init(p, *source, size, cc->options);
-  p->lex_callback = cb;
   mrc_init_presym(&p->constant_pool);
   if (cc->filename_table) {
     pm_string_t filename_string;
@@ -337,7 +312,23 @@ read_input_files(mrc_ccontext *c, const char **filenames, uint8_t **source, mrc_
 static mrc_node *
 mrc_pm_parse(mrc_ccontext *cc)
 {
+  mrc_trace_begin(cc, "parse", cc->filename, 1);
+  uint64_t start = cc->stats ? mrc_stats_clock() : 0;
+  uint64_t allocs, alloc_bytes, allocs1, alloc_bytes1, live, live1, peak;
+  mrc_stats_allocs(&allocs, &alloc_bytes);
+  mrc_stats_live(&live, &peak);
   mrc_node *node = pm_parse(cc->p);
+  mrc_trace_end(cc, "parse");
+  if (cc->stats) {
+    cc->stats->parse_ns += mrc_stats_clock() - start;
+    mrc_stats_allocs(&allocs1, &alloc_bytes1);
+    cc->stats->parse_allocs += allocs1 - allocs;
+    cc->stats->parse_alloc_bytes += alloc_bytes1 - alloc_bytes;
+    mrc_stats_live(&live1, &peak);
+    if (peak - live > cc->stats->parse_peak_bytes) cc->stats->parse_peak_bytes = peak - live;
+    cc->stats->source_bytes += (size_t)(cc->p->end - cc->p->start);
+    cc->stats->source_lines += (uint32_t)cc->p->newline_list.size;
+  }
 
 #if defined(PICORB_VM_MRUBYC)
   // Workaround: save top-level locals for PicoRuby(mruby/c) IRB
@@ -384,7 +375,6 @@ mrc_parse_file_cxt(mrc_ccontext *c, const char **filenames, uint8_t **source)
   }
   c->filename_table = (mrc_filename_table *)mrc_malloc(c, sizeof(mrc_filename_table) * filecount);
   c->filename_table_length = filecount;
-  c->current_filename_index = 0;
   intptr_t length = read_input_files(c, filenames, source, c->filename_table);
   if (length < 0) {
     fprintf(stderr, "Cannot open files: ");
@@ -418,7 +408,6 @@ mrc_parse_string_cxt(mrc_ccontext *c, const uint8_t **source, size_t length)
   c->filename_table[0].filename = c->filename ? c->filename : "-e";
   c->filename_table[0].start = 0;
   c->filename_table_length = 1;
-  c->current_filename_index = 0;
   mrc_pm_parser_init(c->p, (uint8_t **)source, length, c);
   return mrc_pm_parse(c);
 }
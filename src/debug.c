@@ -74,14 +74,48 @@ mrc_packed_int_decode(const uint8_t *p, const uint8_t **newpos)
   return n;
 }
 
+/* line of `pc` straight from the packed map; used when no index can be built */
 static int32_t
-debug_get_line(mrc_irep_debug_info_file* f, uint32_t pc)
+packed_get_line(mrc_irep_debug_info_file* f, uint32_t pc)
 {
-  if (f == NULL) return -1;
+  const uint8_t *p = f->lines.packed_map;
+  const uint8_t *pend = p + f->line_entry_count;
+  uint32_t pos = 0, line = 0;
+  while (p < pend) {
+    pos += mrc_packed_int_decode(p, &p);
+    uint32_t line_diff = mrc_packed_int_decode(p, &p);
+    if (pc < pos) break;
+    line += line_diff;
+  }
+  return line;
+}
+
+static mrc_bool
+build_runs(mrc_ccontext *c, mrc_irep_debug_info_file *f)
+{
+  mrc_irep_debug_line_run *runs;
+  uint32_t n = 0;
+
   switch (f->line_type) {
   case mrc_debug_line_ary:
+    runs = (mrc_irep_debug_line_run*)mrc_malloc(c, sizeof(*runs) * (f->line_entry_count + 1));
+    if (runs == NULL) return FALSE;
+    for (uint32_t i = 0; i < f->line_entry_count; i++) {
+      if (n > 0 && runs[n-1].line == f->lines.ary[i]) continue;
+      runs[n].start_pos = f->start_pos + i;
+      runs[n].line = f->lines.ary[i];
+      n++;
+    }
+    break;
+
   case mrc_debug_line_flat_map:
-  default:
+    runs = (mrc_irep_debug_line_run*)mrc_malloc(c, sizeof(*runs) * (f->line_entry_count + 1));
+    if (runs == NULL) return FALSE;
+    for (uint32_t i = 0; i < f->line_entry_count; i++) {
+      runs[n].start_pos = f->lines.flat_map[i].start_pos;
+      runs[n].line = f->lines.flat_map[i].line;
+      n++;
+    }
     break;
 
   case mrc_debug_line_packed_map:
@@ -89,16 +123,59 @@ debug_get_line(mrc_irep_debug_info_file* f, uint32_t pc)
       const uint8_t *p = f->lines.packed_map;
       const uint8_t *pend = p + f->line_entry_count;
       uint32_t pos = 0, line = 0;
+
+      /* every pair takes at least two bytes; one more for the leading run */
+      runs = (mrc_irep_debug_line_run*)mrc_malloc(c, sizeof(*runs) * (f->line_entry_count / 2 + 1));
+      if (runs == NULL) return FALSE;
+      /* pcs before the first pair are on line 0, as packed_get_line() says */
+      runs[n].start_pos = f->start_pos;
+      runs[n].line = 0;
+      n++;
       while (p < pend) {
         pos += mrc_packed_int_decode(p, &p);
-        uint32_t line_diff = mrc_packed_int_decode(p, &p);
-        if (pc < pos) break;
-        line += line_diff;
+        line += mrc_packed_int_decode(p, &p);
+        if (runs[n-1].start_pos == pos) n--;
+        runs[n].start_pos = pos;
+        runs[n].line = (int32_t)line;
+        n++;
       }
-      return line;
     }
+    break;
+
+  default:
+    return FALSE;
   }
-  return -1;
+  f->runs = runs;
+  f->run_count = n;
+  return TRUE;
+}
+
+/* index of the last run starting at or before `pc`, or -1 */
+static int32_t
+find_run(const mrc_irep_debug_info_file *f, uint32_t pc)
+{
+  uint32_t lo = 0, hi = f->run_count;
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (f->runs[mid].start_pos <= pc) lo = mid + 1;
+    else hi = mid;
+  }
+  return (int32_t)lo - 1;
+}
+
+static int32_t
+debug_get_line(mrc_ccontext *c, mrc_irep_debug_info_file* f, uint32_t pc)
+{
+  if (f == NULL) return -1;
+  if (f->runs == NULL && !build_runs(c, f)) {
+    if (f->line_type == mrc_debug_line_packed_map) return packed_get_line(f, pc);
+    return -1;
+  }
+
+  int32_t i = find_run(f, pc);
+  if (i < 0) return -1;
+  return f->runs[i].line;
 }
 
 int32_t
@@ -106,7 +183,7 @@ mrc_debug_get_line(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc)
 {
   if (irep && pc < irep->ilen) {
     if (!irep->debug_info) return -1;
-    return debug_get_line(get_file(irep->debug_info, pc), pc);
+    return debug_get_line(c, get_file(irep->debug_info, pc), pc);
   }
   return -1;
 }
@@ -129,6 +206,57 @@ mrc_debug_get_filename(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc)
   return NULL;
 }
 
+mrc_bool
+mrc_debug_get_position(mrc_ccontext *c, const mrc_irep *irep, uint32_t pc, int32_t *lp, const char **fp)
+{
+  if (irep && pc < irep->ilen && irep->debug_info) {
+    mrc_irep_debug_info_file *f = get_file(irep->debug_info, pc);
+    if (f) {
+      if (lp) *lp = debug_get_line(c, f, pc);
+      if (fp) *fp = debug_get_filename(c, f);
+      return TRUE;
+    }
+  }
+  if (lp) *lp = -1;
+  if (fp) *fp = NULL;
+  return FALSE;
+}
+
+void
+mrc_debug_line_iter_init(mrc_debug_line_iter *it, const mrc_irep *irep)
+{
+  static const mrc_debug_line_iter initial = { NULL, 0, 0, 0, 0, -1, 0 };
+
+  *it = initial;
+  it->irep = irep;
+}
+
+mrc_bool
+mrc_debug_line_iter_next(mrc_ccontext *c, mrc_debug_line_iter *it)
+{
+  const mrc_irep_debug_info *d = it->irep ? it->irep->debug_info : NULL;
+
+  if (d == NULL) return FALSE;
+  while (it->file < d->flen) {
+    mrc_irep_debug_info_file *f = d->files[it->file];
+
+    if (f->runs == NULL && !build_runs(c, f)) return FALSE;
+    if (it->run < f->run_count) {
+      uint32_t file_end = (it->file + 1 < d->flen) ? d->files[it->file + 1]->start_pos : d->pc_count;
+      const mrc_irep_debug_line_run *r = &f->runs[it->run++];
+
+      it->start_pos = r->start_pos;
+      it->end_pos = (it->run < f->run_count) ? f->runs[it->run].start_pos : file_end;
+      it->line = r->line;
+      it->filename_sym = f->filename_sym;
+      return TRUE;
+    }
+    it->file++;
+    it->run = 0;
+  }
+  return FALSE;
+}
+
 mrc_irep_debug_info*
 mrc_debug_info_alloc(mrc_ccontext *c, mrc_irep *irep)
 {
@@ -143,7 +271,8 @@ mrc_debug_info_alloc(mrc_ccontext *c, mrc_irep *irep)
 
 mrc_irep_debug_info_file*
 mrc_debug_info_append_file(mrc_ccontext *c, mrc_irep_debug_info *d,
-                           const char *filename, uint16_t *lines,
+                           const char *filename,
+                           const mrc_irep_debug_line_run *lines, uint32_t lines_len,
                            uint32_t start_pos, uint32_t end_pos)
 {
   if (!d) return NULL;
@@ -162,11 +291,11 @@ mrc_debug_info_append_file(mrc_ccontext *c, mrc_irep_debug_info *d,
     }
   }
 
+  uint64_t clock_start = c->stats ? mrc_stats_clock() : 0;
   mrc_irep_debug_info_file *f = (mrc_irep_debug_info_file*)mrc_malloc(c, sizeof(*f));
   d->files = (mrc_irep_debug_info_file**)mrc_realloc(c, d->files, sizeof(mrc_irep_debug_info_file*) * (d->flen + 1));
   d->files[d->flen++] = f;
 
-  uint32_t file_pc_count = end_pos - start_pos;
   f->start_pos = start_pos;
   d->pc_count = end_pos;
 
@@ -175,29 +304,45 @@ mrc_debug_info_append_file(mrc_ccontext *c, mrc_irep_debug_info *d,
 
   f->line_type = mrc_debug_line_packed_map;
   f->lines.ptr = NULL;
+  f->run_count = 0;
+  f->runs = NULL;
+
+  /* the run in effect at start_pos, then every run that starts before end_pos */
+  uint32_t first = 0, hi = lines_len;
+  while (first < hi) {
+    uint32_t mid = first + (hi - first) / 2;
+    if (lines[mid].start_pos <= start_pos) first = mid + 1;
+    else hi = mid;
+  }
+  if (first > 0) first--;
 
-  uint16_t prev_line = 0;
+  uint32_t prev_line = 0;
   uint32_t prev_pc = 0;
   size_t packed_size = 0;
   uint8_t *p;
 
-  for (uint32_t i = 0; i < file_pc_count; i++) {
-    if (lines[start_pos + i] == prev_line) continue;
-    packed_size += mrc_packed_int_len(start_pos+i-prev_pc);
-    prev_pc = start_pos+i;
-    packed_size += mrc_packed_int_len(lines[start_pos+i]-prev_line);
-    prev_line = lines[start_pos + i];
+  for (uint32_t i = first; i < lines_len && lines[i].start_pos < end_pos; i++) {
+    uint32_t pc = lines[i].start_pos < start_pos ? start_pos : lines[i].start_pos;
+    uint32_t line = (uint32_t)lines[i].line;
+    if (line == prev_line) continue;
+    packed_size += mrc_packed_int_len(pc-prev_pc);
+    prev_pc = pc;
+    packed_size += mrc_packed_int_len(line-prev_line);
+    prev_line = line;
   }
   f->lines.packed_map = p = (uint8_t*)mrc_malloc(c, packed_size);
   prev_line = 0; prev_pc = 0;
-  for (uint32_t i = 0; i < file_pc_count; i++) {
-    if (lines[start_pos + i] == prev_line) continue;
-    p += mrc_packed_int_encode(start_pos+i-prev_pc, p);
-    prev_pc = start_pos + i;
-    p += mrc_packed_int_encode(lines[start_pos + i]-prev_line, p);
-    prev_line = lines[start_pos + i];
+  for (uint32_t i = first; i < lines_len && lines[i].start_pos < end_pos; i++) {
+    uint32_t pc = lines[i].start_pos < start_pos ? start_pos : lines[i].start_pos;
+    uint32_t line = (uint32_t)lines[i].line;
+    if (line == prev_line) continue;
+    p += mrc_packed_int_encode(pc-prev_pc, p);
+    prev_pc = pc;
+    p += mrc_packed_int_encode(line-prev_line, p);
+    prev_line = line;
   }
   f->line_entry_count = (uint32_t)packed_size;
+  if (c->stats) c->stats->debug_info_ns += mrc_stats_clock() - clock_start;
 
   return f;
 }
@@ -211,6 +356,7 @@ mrc_debug_info_free(mrc_ccontext *c, mrc_irep_debug_info *d)
     for (uint32_t i = 0; i < d->flen; i++) {
       if (d->files[i]) {
         mrc_free(c, d->files[i]->lines.ptr);
+        mrc_free(c, d->files[i]->runs);
         mrc_free(c, d->files[i]);
       }
     }
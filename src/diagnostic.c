@@ -1,28 +1,7 @@
+#include <string.h>
+#include "../include/mrc_ccontext.h"
 #include "../include/mrc_diagnostic.h"
-
-static void
-line_and_column_by_start_and_offset(const uint8_t *source_start, const uint8_t *location_start, uint32_t *line, uint32_t *column)
-{
-  if (!location_start) {
-    *line = 0;
-    *column = 0;
-    return;
-  }
-  uint32_t start_offset = (uint32_t)(location_start - source_start);
-  uint32_t l = 1, c = 1;
-  const uint8_t *p = source_start;
-  while (p < source_start + start_offset) {
-    if (*p == '\n') {
-      l++;
-      c = 1;
-    } else {
-      c++;
-    }
-    p++;
-  }
-  *line = l;
-  *column = c;
-}
+#include "../include/mrc_position.h"
 
 /*
   const char *level;
@@ -61,45 +40,70 @@ mrc_diagnostic_code_to_string(mrc_diagnostic_code code)
 void
 mrc_diagnostic_list_append(mrc_ccontext *c, const uint8_t * location_start, const char *message, mrc_diagnostic_code code)
 {
+  if (code == MRC_PARSER_ERROR || code == MRC_GENERATOR_ERROR) {
+    c->capture_errors = TRUE;
+  }
+  if ((unsigned)code < MRC_DIAGNOSTIC_CODE_COUNT) {
+    c->diagnostic_counts[code]++;
+  }
+  /* past the limit only the counts are kept; nothing is resolved or copied */
+  if (c->diagnostic_count_only) return;
+  if (0 < c->diagnostic_limit && c->diagnostic_limit <= c->diagnostic_length) return;
+
   mrc_diagnostic_list *list = (mrc_diagnostic_list *)mrc_calloc(c, 1, sizeof(mrc_diagnostic_list));
-  const uint8_t *file_start = c->p->start;
+  mrc_position pos;
   list->filename = NULL;
+  if (mrc_position_resolve(c, location_start, &pos)) {
 #ifndef MRC_NO_STDIO
-  if (c->filename_table && 0 < c->filename_table_length && location_start) {
-    uint32_t offset = (uint32_t)(location_start - c->p->start);
-    int file_idx = 0;
-    for (int i = 1; i < c->filename_table_length; i++) {
-      if (offset < c->filename_table[i].start) break;
-      file_idx = i;
+    if (c->filename_table && 0 < c->filename_table_length) {
+      list->filename = c->filename_table[pos.file].filename;
     }
-    list->filename = c->filename_table[file_idx].filename;
-    file_start = c->p->start + c->filename_table[file_idx].start;
-  }
 #endif
-  line_and_column_by_start_and_offset(file_start, location_start, &list->line, &list->column);
-  char buf[256];
+    list->line = pos.line;
+    list->column = pos.column;
+  }
+  /* "<code>, <message>", sized to fit */
   const char *diagnostic_code_str = mrc_diagnostic_code_to_string(code);
-  snprintf(buf, sizeof(buf), "%s, %s", diagnostic_code_str, message);
-  size_t len = strlen(buf);
-  list->message = (char *)mrc_malloc(c, len + 1);
-  memcpy(list->message, buf, len + 1);
+  size_t prefix_len = strlen(diagnostic_code_str) + 2;
+  size_t len = strlen(message);
+  list->message = (char *)mrc_malloc(c, prefix_len + len + 1);
+  memcpy(list->message, diagnostic_code_str, prefix_len - 2);
+  memcpy(list->message + prefix_len - 2, ", ", 2);
+  memcpy(list->message + prefix_len, message, len + 1);
+  list->text = list->message + prefix_len;
   list->code = code;
 
-  if (c->diagnostic_list == NULL) {
+  if (c->diagnostic_tail == NULL) {
     c->diagnostic_list = list;
   } else {
-    mrc_diagnostic_list *p = c->diagnostic_list;
-    while (p->next) {
-      p = p->next;
-    }
-    p->next = list;
+    c->diagnostic_tail->next = list;
   }
+  c->diagnostic_tail = list;
+  c->diagnostic_length++;
+}
 
-  if (code == MRC_PARSER_ERROR || code == MRC_GENERATOR_ERROR) {
-    c->capture_errors = TRUE;
+void
+mrc_diagnostic_each(const mrc_ccontext *c, mrc_diagnostic_func *func, void *ud)
+{
+  for (const mrc_diagnostic_list *d = c->diagnostic_list; d; d = d->next) {
+    mrc_diagnostic diag;
+
+    diag.code = d->code;
+    diag.filename = d->filename;
+    diag.line = d->line;
+    diag.column = d->column;
+    diag.message = d->text;
+    if (!func(&diag, ud)) break;
   }
 }
 
+uint32_t
+mrc_diagnostic_count(const mrc_ccontext *c, mrc_diagnostic_code code)
+{
+  if ((unsigned)code >= MRC_DIAGNOSTIC_CODE_COUNT) return 0;
+  return c->diagnostic_counts[code];
+}
+
 void
 mrc_diagnostic_list_free(mrc_ccontext *c)
 {
@@ -111,4 +115,7 @@ mrc_diagnostic_list_free(mrc_ccontext *c)
     p = next;
   }
   c->diagnostic_list = NULL;
+  c->diagnostic_tail = NULL;
+  c->diagnostic_length = 0;
+  memset(c->diagnostic_counts, 0, sizeof(c->diagnostic_counts));
 }
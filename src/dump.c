@@ -5,6 +5,8 @@
 #include "../include/mrc_parser_util.h"
 #include "../include/mrc_debug.h"
 #include "../include/mrc_irep_pool_type.h"
+#include "../include/mrc_symtab.h"
+#include "../include/mrc_trace.h"
 
 #if !defined(BYTE_ORDER) && defined(__BYTE_ORDER__)
 # define BYTE_ORDER __BYTE_ORDER__
@@ -35,12 +37,69 @@ check_little_endian(void)
 #endif
 
 
-static size_t get_irep_record_size_1(mrc_ccontext *c, const mrc_irep *irep);
-
 #if UINT32_MAX > SIZE_MAX
 # error This code cannot be built on your environment.
 #endif
 
+/* Record sizes of every irep, measured once in the order the records are
+   written (depth first, parent before children). The allocation, the record
+   headers and the final size check all read them from here, so no irep is
+   measured twice and no symbol name is looked up more than once for sizing. */
+typedef struct irep_record_sizes {
+  size_t *sizes;                /* record size of the n-th irep */
+  size_t total;                 /* sum of sizes[] */
+  size_t cursor;                /* next irep to be written */
+} irep_record_sizes;
+
+/* Pool strings of the whole irep tree, for the STRT section
+   (MRC_DUMP_STRTAB). A string used by a single pool entry stays inline, where
+   it is smaller than an index plus a table entry. */
+typedef struct lit_str {
+  const char *ptr;
+  uint32_t len;
+  uint32_t hash;
+  uint32_t count;               /* pool entries using it */
+  uint32_t index;               /* in STRT, or RITE_STRTAB_MAX if inline */
+} lit_str;
+
+typedef struct lit_str_table {
+  lit_str *strs;                /* in first-seen order */
+  uint32_t len;
+  uint32_t capa;
+  uint32_t *slots;              /* index into strs plus one; 0 is empty */
+  uint32_t slot_capa;           /* power of two */
+  uint32_t shared;              /* number of strings written to STRT */
+} lit_str_table;
+
+/* program-wide tables the IREP records refer to (NULL when not dumped), and
+   the record layout */
+typedef struct dump_tables {
+  const mrc_symtab *syms;
+  const lit_str_table *strs;
+  mrc_bool aligned;             /* MRC_DUMP_ALIGNED */
+  size_t records_offset;        /* image offset of the first IREP record */
+  const uint8_t *image;         /* start of the image being written */
+} dump_tables;
+
+/* Under MRC_DUMP_ALIGNED the writer inserts zero bytes so that a block lands
+   on a multiple of `align` counted from the start of the image; a loader
+   skips the same amount from the same offsets. */
+static size_t
+dump_padding(const dump_tables *tables, size_t pos, size_t align)
+{
+  if (!tables->aligned) return 0;
+  return (align - pos % align) % align;
+}
+
+static ptrdiff_t
+write_padding(const dump_tables *tables, uint8_t *cur, size_t align)
+{
+  size_t pad = dump_padding(tables, (size_t)(cur - tables->image), align);
+
+  memset(cur, 0, pad);
+  return (ptrdiff_t)pad;
+}
+
 static size_t
 get_irep_header_size(mrc_ccontext *c)
 {
@@ -53,11 +112,12 @@ get_irep_header_size(mrc_ccontext *c)
 }
 
 static ptrdiff_t
-write_irep_header(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
+write_irep_header(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, size_t record_size)
 {
   uint8_t *cur = buf;
 
-  cur += mrc_uint32_to_bin((uint32_t)get_irep_record_size_1(c, irep), cur);  /* record size */
+  mrc_assert_int_fit(size_t, record_size, uint32_t, UINT32_MAX);
+  cur += mrc_uint32_to_bin((uint32_t)record_size, cur);  /* record size */
   cur += mrc_uint16_to_bin((uint16_t)irep->nlocals, cur);  /* number of local variable */
   cur += mrc_uint16_to_bin((uint16_t)irep->nregs, cur);  /* number of register variable */
   cur += mrc_uint16_to_bin((uint16_t)irep->rlen, cur);  /* number of child irep */
@@ -66,12 +126,13 @@ write_irep_header(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
 }
 
 static size_t
-get_iseq_block_size(mrc_ccontext *c, const mrc_irep *irep)
+get_iseq_block_size(mrc_ccontext *c, const mrc_irep *irep, const dump_tables *tables, size_t pos)
 {
   size_t size = 0;
 
   size += sizeof(uint16_t); /* clen */
   size += sizeof(uint32_t); /* ilen */
+  size += dump_padding(tables, pos + size, MRC_DUMP_ALIGNMENT);
   size += irep->ilen * sizeof(mrc_code); /* iseq(n) */
   size += irep->clen * sizeof(struct mrc_irep_catch_handler);
 
@@ -79,7 +140,7 @@ get_iseq_block_size(mrc_ccontext *c, const mrc_irep *irep)
 }
 
 static ptrdiff_t
-write_iseq_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, uint8_t flags)
+write_iseq_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, uint8_t flags, const dump_tables *tables)
 {
   uint8_t *cur = buf;
   size_t seqlen = irep->ilen * sizeof(mrc_code) +
@@ -87,6 +148,8 @@ write_iseq_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, uint8_t fl
 
   cur += mrc_uint16_to_bin(irep->clen, cur); /* number of catch handlers */
   cur += mrc_uint32_to_bin(irep->ilen, cur); /* number of opcode */
+  /* the catch handler table follows the iseq directly, as it does in memory */
+  cur += write_padding(tables, cur, MRC_DUMP_ALIGNMENT);
   memcpy(cur, irep->iseq, seqlen);
   cur += seqlen;
 
@@ -114,18 +177,122 @@ dump_float(mrc_ccontext *c, uint8_t *buf, mrc_float f)
 }
 #endif
 
+static uint32_t
+lit_str_hash(const char *ptr, uint32_t len)
+{
+  uint32_t h = 2166136261U;     /* FNV-1a */
+
+  for (uint32_t i = 0; i < len; i++) {
+    h = (h ^ (uint8_t)ptr[i]) * 16777619U;
+  }
+  return h;
+}
+
+static uint32_t*
+lit_str_slot(const lit_str_table *t, const char *ptr, uint32_t len, uint32_t hash)
+{
+  uint32_t mask = t->slot_capa - 1;
+  uint32_t i = hash & mask;
+
+  while (t->slots[i] != 0) {
+    const lit_str *ls = &t->strs[t->slots[i] - 1];
+    /* len==0 may come with a NULL ptr; memcmp must not see it */
+    if (ls->hash == hash && ls->len == len && (len == 0 || memcmp(ls->ptr, ptr, len) == 0)) break;
+    i = (i + 1) & mask;
+  }
+  return &t->slots[i];
+}
+
+static void
+lit_str_add(mrc_ccontext *c, lit_str_table *t, const char *ptr, uint32_t len)
+{
+  uint32_t hash = lit_str_hash(ptr, len);
+  uint32_t *slot;
+
+  if ((t->len + 1) * 2 > t->slot_capa) {
+    uint32_t old_capa = t->slot_capa;
+    uint32_t *old_slots = t->slots;
+
+    t->slot_capa = old_capa == 0 ? 16 : old_capa * 2;
+    t->slots = (uint32_t*)mrc_calloc(c, t->slot_capa, sizeof(uint32_t));
+    for (uint32_t i = 0; i < old_capa; i++) {
+      if (old_slots[i] != 0) {
+        const lit_str *ls = &t->strs[old_slots[i] - 1];
+        *lit_str_slot(t, ls->ptr, ls->len, ls->hash) = old_slots[i];
+      }
+    }
+    mrc_free(c, old_slots);
+  }
+
+  slot = lit_str_slot(t, ptr, len, hash);
+  if (*slot != 0) {
+    t->strs[*slot - 1].count++;
+    return;
+  }
+  if (t->len == t->capa) {
+    t->capa = t->capa == 0 ? 8 : t->capa * 2;
+    t->strs = (lit_str*)mrc_realloc(c, t->strs, sizeof(lit_str) * t->capa);
+  }
+  t->strs[t->len] = (lit_str){ ptr, len, hash, 1, RITE_STRTAB_MAX };
+  *slot = ++t->len;
+}
+
+static void
+collect_lit_strs(mrc_ccontext *c, const mrc_irep *irep, lit_str_table *t)
+{
+  for (int i = 0; i < irep->plen; i++) {
+    const mrc_pool_value *pv = &irep->pool[i];
+    if (pv->tt & IREP_TT_NFLAG) continue;
+    lit_str_add(c, t, pv->u.str, pv->tt >> 2);
+  }
+  for (int i = 0; i < irep->rlen; i++) {
+    collect_lit_strs(c, irep->reps[i], t);
+  }
+}
+
+static void
+create_lit_str_table(mrc_ccontext *c, const mrc_irep *irep, lit_str_table *t)
+{
+  collect_lit_strs(c, irep, t);
+  for (uint32_t i = 0; i < t->len && t->shared < RITE_STRTAB_MAX; i++) {
+    if (t->strs[i].count > 1) {
+      t->strs[i].index = t->shared++;
+    }
+  }
+}
+
+static void
+lit_str_table_free(mrc_ccontext *c, lit_str_table *t)
+{
+  mrc_free(c, t->strs);
+  mrc_free(c, t->slots);
+}
+
+/* STRT index of a pool string, or RITE_STRTAB_MAX to write it inline */
+static uint32_t
+shared_lit_str_index(const lit_str_table *t, const mrc_pool_value *pv)
+{
+  if (t == NULL || t->shared == 0) return RITE_STRTAB_MAX;
+
+  uint32_t len = pv->tt >> 2;
+  uint32_t slot = *lit_str_slot(t, pv->u.str, len, lit_str_hash(pv->u.str, len));
+  return slot == 0 ? RITE_STRTAB_MAX : t->strs[slot - 1].index;
+}
+
 static size_t
-get_pool_block_size(mrc_ccontext *c, const mrc_irep *irep)
+get_pool_block_size(mrc_ccontext *c, const mrc_irep *irep, const dump_tables *tables, size_t pos)
 {
   int pool_no;
   size_t size = 0;
+  const lit_str_table *strs = tables->strs;
 
   size += sizeof(uint16_t); /* plen */
-  size += irep->plen * sizeof(uint8_t); /* len(n) */
 
   for (pool_no = 0; pool_no < irep->plen; pool_no++) {
     int ai = mrc_gc_arena_save(c);
 
+    size += sizeof(uint8_t); /* data type */
+
     switch (irep->pool[pool_no].tt) {
     case IREP_TT_INT64:
 #if defined(MRC_64BIT) || defined(MRC_INT64)
@@ -133,7 +300,7 @@ get_pool_block_size(mrc_ccontext *c, const mrc_irep *irep)
         int64_t i = irep->pool[pool_no].u.i64;
 
         if (i < INT32_MIN || INT32_MAX < i)
-          size += 8;
+          size += dump_padding(tables, pos + size, sizeof(int64_t)) + 8;
         else
           size += 4;
       }
@@ -158,13 +325,17 @@ get_pool_block_size(mrc_ccontext *c, const mrc_irep *irep)
     case IREP_TT_FLOAT:
 #ifndef MRC_NO_FLOAT
       {
+        size += dump_padding(tables, pos + size, sizeof(double));
         size += sizeof(double);
       }
 #endif
       break;
 
     default: /*  packed IREP_TT_STRING */
-      {
+      if (shared_lit_str_index(strs, &irep->pool[pool_no]) != RITE_STRTAB_MAX) {
+        size += sizeof(uint16_t); /* index into STRT */
+      }
+      else {
         mrc_int len = irep->pool[pool_no].tt >> 2; /* unpack length */
         mrc_assert_int_fit(mrc_int, len, size_t, SIZE_MAX);
         size += sizeof(uint16_t);
@@ -179,8 +350,9 @@ get_pool_block_size(mrc_ccontext *c, const mrc_irep *irep)
 }
 
 static ptrdiff_t
-write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
+write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, const dump_tables *tables)
 {
+  const lit_str_table *strs = tables->strs;
   int pool_no;
   uint8_t *cur = buf;
   mrc_int len;
@@ -198,6 +370,7 @@ write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
         int64_t i = irep->pool[pool_no].u.i64;
         if (i < INT32_MIN || INT32_MAX < i) {
           cur += mrc_uint8_to_bin(IREP_TT_INT64, cur); /* data type */
+          cur += write_padding(tables, cur, sizeof(int64_t));
           cur += mrc_uint32_to_bin((uint32_t)((i>>32) & 0xffffffff), cur); /* i64 hi */
           cur += mrc_uint32_to_bin((uint32_t)((i    ) & 0xffffffff), cur); /* i64 lo */
         }
@@ -224,6 +397,7 @@ write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
       cur += mrc_uint8_to_bin(IREP_TT_FLOAT, cur); /* data type */
 #ifndef MRC_NO_FLOAT
       {
+        cur += write_padding(tables, cur, sizeof(double));
         dump_float(c, cur,irep->pool[pool_no].u.f);
         cur += sizeof(double);
       }
@@ -233,6 +407,14 @@ write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
       break;
 
     default: /* string */
+      {
+        uint32_t idx = shared_lit_str_index(strs, &irep->pool[pool_no]);
+        if (idx != RITE_STRTAB_MAX) {
+          cur += mrc_uint8_to_bin(IREP_TT_SHARED_STR, cur); /* data type */
+          cur += mrc_uint16_to_bin((uint16_t)idx, cur); /* index into STRT */
+          break;
+        }
+      }
       cur += mrc_uint8_to_bin(IREP_TT_STR, cur); /* data type */
       ptr = irep->pool[pool_no].u.str;
       len = irep->pool[pool_no].tt>>2;
@@ -250,13 +432,16 @@ write_pool_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
 }
 
 static size_t
-get_syms_block_size(mrc_ccontext *c, const mrc_irep *irep)
+get_syms_block_size(mrc_ccontext *c, const mrc_irep *irep, const mrc_symtab *symtab)
 {
   size_t size = 0;
   int sym_no;
   mrc_int len;
 
   size += sizeof(uint16_t); /* slen */
+  if (symtab) {
+    return size + sizeof(uint16_t) * irep->slen; /* index into SYMT */
+  }
   for (sym_no = 0; sym_no < irep->slen; sym_no++) {
     size += sizeof(uint16_t); /* snl(n) */
     if (irep->syms[sym_no] != 0) {
@@ -269,7 +454,7 @@ get_syms_block_size(mrc_ccontext *c, const mrc_irep *irep)
 }
 
 static ptrdiff_t
-write_syms_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
+write_syms_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf, const mrc_symtab *symtab)
 {
   int sym_no;
   uint8_t *cur = buf;
@@ -277,6 +462,18 @@ write_syms_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
 
   cur += mrc_uint16_to_bin(irep->slen, cur); /* number of symbol */
 
+  if (symtab) {
+    for (sym_no = 0; sym_no < irep->slen; sym_no++) {
+      uint16_t idx = RITE_SYMTAB_NULL_INDEX;
+
+      if (irep->syms[sym_no] != 0) {
+        idx = (uint16_t)mrc_symtab_find(symtab, irep->syms[sym_no]);
+      }
+      cur += mrc_uint16_to_bin(idx, cur); /* index into SYMT */
+    }
+    return cur - buf;
+  }
+
   for (sym_no = 0; sym_no < irep->slen; sym_no++) {
     if (irep->syms[sym_no] != 0) {
       mrc_int len;
@@ -298,31 +495,56 @@ write_syms_block(mrc_ccontext *c, const mrc_irep *irep, uint8_t *buf)
 }
 
 static size_t
-get_irep_record_size_1(mrc_ccontext *c, const mrc_irep *irep)
+get_irep_record_size_1(mrc_ccontext *c, const mrc_irep *irep, const dump_tables *tables, size_t pos)
 {
   size_t size = 0;
 
   size += get_irep_header_size(c);
-  size += get_iseq_block_size(c, irep);
-  size += get_pool_block_size(c, irep);
-  size += get_syms_block_size(c, irep);
+  size += get_iseq_block_size(c, irep, tables, pos + size);
+  size += get_pool_block_size(c, irep, tables, pos + size);
+  size += get_syms_block_size(c, irep, tables->syms);
   return size;
 }
 
 static size_t
-get_irep_record_size(mrc_ccontext *c, const mrc_irep *irep)
+count_ireps(const mrc_irep *irep)
 {
-  size_t size = 0;
+  size_t n = 1;
 
-  size = get_irep_record_size_1(c, irep);
   for (int irep_no = 0; irep_no < irep->rlen; irep_no++) {
-    size += get_irep_record_size(c, irep->reps[irep_no]);
+    n += count_ireps(irep->reps[irep_no]);
+  }
+  return n;
+}
+
+static void
+measure_irep_records(mrc_ccontext *c, const mrc_irep *irep, const dump_tables *tables, irep_record_sizes *rs)
+{
+  size_t size = get_irep_record_size_1(c, irep, tables, tables->records_offset + rs->total);
+
+  rs->sizes[rs->cursor++] = size;
+  rs->total += size;
+  for (int irep_no = 0; irep_no < irep->rlen; irep_no++) {
+    measure_irep_records(c, irep->reps[irep_no], tables, rs);
   }
-  return size;
 }
 
 static int
-write_irep_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *irep_record_size, uint8_t flags)
+irep_record_sizes_init(mrc_ccontext *c, const mrc_irep *irep, const dump_tables *tables, irep_record_sizes *rs)
+{
+  rs->sizes = (size_t*)mrc_malloc(c, sizeof(size_t) * count_ireps(irep));
+  rs->total = 0;
+  rs->cursor = 0;
+  if (rs->sizes == NULL) {
+    return MRC_DUMP_GENERAL_FAILURE;
+  }
+  measure_irep_records(c, irep, tables, rs);
+  rs->cursor = 0;
+  return MRC_DUMP_OK;
+}
+
+static int
+write_irep_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *irep_record_size, uint8_t flags, irep_record_sizes *rs, const dump_tables *tables)
 {
   uint8_t *src = bin;
 
@@ -330,16 +552,16 @@ write_irep_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *i
     return MRC_DUMP_INVALID_IREP;
   }
 
-  bin += write_irep_header(c, irep, bin);
-  bin += write_iseq_block(c, irep, bin, flags);
-  bin += write_pool_block(c, irep, bin);
-  bin += write_syms_block(c, irep, bin);
+  bin += write_irep_header(c, irep, bin, rs->sizes[rs->cursor++]);
+  bin += write_iseq_block(c, irep, bin, flags, tables);
+  bin += write_pool_block(c, irep, bin, tables);
+  bin += write_syms_block(c, irep, bin, tables->syms);
 
   for (int i = 0; i < irep->rlen; i++) {
     int result;
     size_t rsize;
 
-    result = write_irep_record(c, irep->reps[i], bin, &rsize, flags);
+    result = write_irep_record(c, irep->reps[i], bin, &rsize, flags, rs, tables);
     if (result != MRC_DUMP_OK) {
       return result;
     }
@@ -363,11 +585,12 @@ write_footer(mrc_ccontext *c, uint8_t *bin)
 
 
 static int
-write_section_irep_header(mrc_ccontext *c, size_t section_size, uint8_t *bin)
+write_section_irep_header(mrc_ccontext *c, size_t section_size, uint8_t *bin, mrc_bool aligned)
 {
   struct rite_section_irep_header *header = (struct rite_section_irep_header*)bin;
 
-  memcpy(header->section_ident, RITE_SECTION_IREP_IDENT, sizeof(header->section_ident));
+  memcpy(header->section_ident, aligned ? RITE_SECTION_IREP_ALIGNED_IDENT : RITE_SECTION_IREP_IDENT,
+         sizeof(header->section_ident));
 
   mrc_assert_int_fit(size_t, section_size, uint32_t, UINT32_MAX);
   mrc_uint32_to_bin((uint32_t)section_size, header->section_size);
@@ -377,7 +600,7 @@ write_section_irep_header(mrc_ccontext *c, size_t section_size, uint8_t *bin)
 }
 
 static int
-write_section_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *len_p, uint8_t flags)
+write_section_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *len_p, uint8_t flags, irep_record_sizes *rs, const dump_tables *tables)
 {
   int result;
   size_t rsize = 0;
@@ -389,13 +612,103 @@ write_section_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, size_t *
 
   cur += sizeof(struct rite_section_irep_header);
 
-  result = write_irep_record(c, irep, cur, &rsize, flags);
+  result = write_irep_record(c, irep, cur, &rsize, flags, rs, tables);
   if (result != MRC_DUMP_OK) {
     return result;
   }
-  mrc_assert(rsize == get_irep_record_size(c, irep));
+  mrc_assert(rsize == rs->total);
   *len_p = cur - bin + rsize;
-  write_section_irep_header(c, *len_p, bin);
+  write_section_irep_header(c, *len_p, bin, tables->aligned);
+
+  return MRC_DUMP_OK;
+}
+
+static void
+create_global_sym_table(mrc_ccontext *c, const mrc_irep *irep, mrc_symtab *syms)
+{
+  for (int i = 0; i < irep->slen; i++) {
+    if (irep->syms[i] != 0) {
+      mrc_symtab_add(c, syms, irep->syms[i], NULL);
+    }
+  }
+  for (int i = 0; i < irep->rlen; i++) {
+    create_global_sym_table(c, irep->reps[i], syms);
+  }
+}
+
+static size_t
+get_symtab_section_size(mrc_ccontext *c, const mrc_symtab *syms)
+{
+  size_t size = sizeof(struct rite_section_symtab_header);
+  mrc_int len;
+
+  size += sizeof(uint16_t); /* number of symbols */
+  for (uint32_t i = 0; i < syms->len; i++) {
+    mrc_sym_name_len(c, syms->syms[i], &len);
+    size += sizeof(uint16_t) + len + 1; /* snl(n) + sn(n) + null char */
+  }
+  return size;
+}
+
+static int
+write_section_symtab(mrc_ccontext *c, uint8_t *start, const mrc_symtab *syms)
+{
+  struct rite_section_symtab_header *header = (struct rite_section_symtab_header*)start;
+  uint8_t *cur = start + sizeof(struct rite_section_symtab_header);
+
+  cur += mrc_uint16_to_bin((uint16_t)syms->len, cur);
+  for (uint32_t i = 0; i < syms->len; i++) {
+    mrc_int len;
+    const char *name = mrc_sym_name_len(c, syms->syms[i], &len);
+
+    mrc_assert_int_fit(mrc_int, len, uint16_t, UINT16_MAX);
+    cur += mrc_uint16_to_bin((uint16_t)len, cur);
+    memcpy(cur, name, len);
+    cur += len;
+    *cur++ = '\0';
+  }
+
+  memcpy(header->section_ident, RITE_SECTION_SYMTAB_IDENT, sizeof(header->section_ident));
+  mrc_assert_int_fit(ptrdiff_t, cur - start, uint32_t, UINT32_MAX);
+  mrc_uint32_to_bin((uint32_t)(cur - start), header->section_size);
+
+  return MRC_DUMP_OK;
+}
+
+static size_t
+get_strtab_section_size(mrc_ccontext *c, const lit_str_table *strs)
+{
+  size_t size = sizeof(struct rite_section_strtab_header);
+
+  size += sizeof(uint16_t); /* number of strings */
+  for (uint32_t i = 0; i < strs->len; i++) {
+    if (strs->strs[i].index == RITE_STRTAB_MAX) continue;
+    size += sizeof(uint16_t) + strs->strs[i].len + 1; /* length + string + null char */
+  }
+  return size;
+}
+
+static int
+write_section_strtab(mrc_ccontext *c, uint8_t *start, const lit_str_table *strs)
+{
+  struct rite_section_strtab_header *header = (struct rite_section_strtab_header*)start;
+  uint8_t *cur = start + sizeof(struct rite_section_strtab_header);
+
+  cur += mrc_uint16_to_bin((uint16_t)strs->shared, cur);
+  /* indexes were given in this same order */
+  for (uint32_t i = 0; i < strs->len; i++) {
+    const lit_str *ls = &strs->strs[i];
+
+    if (ls->index == RITE_STRTAB_MAX) continue;
+    cur += mrc_uint16_to_bin((uint16_t)ls->len, cur);
+    if (ls->len) memcpy(cur, ls->ptr, ls->len);
+    cur += ls->len;
+    *cur++ = '\0';
+  }
+
+  memcpy(header->section_ident, RITE_SECTION_STRTAB_IDENT, sizeof(header->section_ident));
+  mrc_assert_int_fit(ptrdiff_t, cur - start, uint32_t, UINT32_MAX);
+  mrc_uint32_to_bin((uint32_t)(cur - start), header->section_size);
 
   return MRC_DUMP_OK;
 }
@@ -441,47 +754,34 @@ get_debug_record_size(mrc_ccontext *c, const mrc_irep *irep)
   return ret;
 }
 
-static int
-find_filename_index(const mrc_sym *ary, int ary_len, mrc_sym s)
-{
-  for (int i = 0; i < ary_len; i++) {
-    if (ary[i] == s) { return i; }
-  }
-  return -1;
-}
-
 static size_t
-get_filename_table_size(mrc_ccontext *c, const mrc_irep *irep, mrc_sym **fp, uint16_t *lp)
+get_filename_table_size(mrc_ccontext *c, const mrc_irep *irep, mrc_symtab *filenames)
 {
-  mrc_sym *filenames = *fp;
   size_t size = 0;
   const mrc_irep_debug_info *di = irep->debug_info;
 
-  mrc_assert(lp);
   for (int i = 0; i < di->flen; i++) {
     mrc_irep_debug_info_file *file;
     mrc_int filename_len;
 
     file = di->files[i];
-    if (find_filename_index(filenames, *lp, file->filename_sym) == -1) {
-      /* register filename */
-      *lp += 1;
-      *fp = filenames = (mrc_sym*)mrc_realloc(c, filenames, sizeof(mrc_sym) * (*lp));
-      filenames[*lp - 1] = file->filename_sym;
+    mrc_bool added;
 
+    mrc_symtab_add(c, filenames, file->filename_sym, &added);
+    if (added) {
       /* filename */
       mrc_sym_name_len(c, file->filename_sym, &filename_len);
       size += sizeof(uint16_t) + (size_t)filename_len;
     }
   }
   for (int i=0; i<irep->rlen; i++) {
-    size += get_filename_table_size(c, irep->reps[i], fp, lp);
+    size += get_filename_table_size(c, irep->reps[i], filenames);
   }
   return size;
 }
 
 static size_t
-write_debug_record_1(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, mrc_sym const* filenames, uint16_t filenames_len)
+write_debug_record_1(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, const mrc_symtab *filenames)
 {
   uint8_t *cur;
   ptrdiff_t ret;
@@ -497,8 +797,7 @@ write_debug_record_1(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, mrc_sy
     cur += mrc_uint32_to_bin(file->start_pos, cur);
 
     /* filename index */
-    filename_idx = find_filename_index(filenames, filenames_len,
-                                                  file->filename_sym);
+    filename_idx = mrc_symtab_find(filenames, file->filename_sym);
     mrc_assert_int_fit(int, filename_idx, uint16_t, UINT16_MAX);
     cur += mrc_uint16_to_bin((uint16_t)filename_idx, cur);
 
@@ -539,13 +838,13 @@ write_debug_record_1(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, mrc_sy
 }
 
 static size_t
-write_debug_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, mrc_sym const* filenames, uint16_t filenames_len)
+write_debug_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, const mrc_symtab *filenames)
 {
-  size_t size = write_debug_record_1(c, irep, bin, filenames, filenames_len);
+  size_t size = write_debug_record_1(c, irep, bin, filenames);
 
   bin += size;
   for (int irep_no = 0; irep_no < irep->rlen; irep_no++) {
-    size_t len = write_debug_record(c, irep->reps[irep_no], bin, filenames, filenames_len);
+    size_t len = write_debug_record(c, irep->reps[irep_no], bin, filenames);
     bin += len;
     size += len;
   }
@@ -555,7 +854,7 @@ write_debug_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t *bin, mrc_sym
 }
 
 static int
-write_section_debug(mrc_ccontext *c, const mrc_irep *irep, uint8_t *cur, mrc_sym const *filenames, uint16_t filenames_len)
+write_section_debug(mrc_ccontext *c, const mrc_irep *irep, uint8_t *cur, const mrc_symtab *filenames)
 {
   size_t section_size = 0;
   const uint8_t *bin = cur;
@@ -571,13 +870,14 @@ write_section_debug(mrc_ccontext *c, const mrc_irep *irep, uint8_t *cur, mrc_sym
   section_size += sizeof(struct rite_section_debug_header);
 
   /* filename table */
-  cur += mrc_uint16_to_bin(filenames_len, cur);
+  mrc_assert_int_fit(uint32_t, filenames->len, uint16_t, UINT16_MAX);
+  cur += mrc_uint16_to_bin((uint16_t)filenames->len, cur);
   section_size += sizeof(uint16_t);
-  for (int i = 0; i < filenames_len; i++) {
+  for (uint32_t i = 0; i < filenames->len; i++) {
     char const *sym;
     mrc_int sym_len;
 
-    sym = mrc_sym_name_len(c, filenames[i], &sym_len);
+    sym = mrc_sym_name_len(c, filenames->syms[i], &sym_len);
     mrc_assert(sym);
     cur += mrc_uint16_to_bin((uint16_t)sym_len, cur);
     memcpy(cur, sym, sym_len);
@@ -586,7 +886,7 @@ write_section_debug(mrc_ccontext *c, const mrc_irep *irep, uint8_t *cur, mrc_sym
   }
 
   /* debug records */
-  dlen = write_debug_record(c, irep, cur, filenames, filenames_len);
+  dlen = write_debug_record(c, irep, cur, filenames);
   section_size += dlen;
 
   memcpy(header->section_ident, RITE_SECTION_DEBUG_IDENT, sizeof(header->section_ident));
@@ -597,43 +897,35 @@ write_section_debug(mrc_ccontext *c, const mrc_irep *irep, uint8_t *cur, mrc_sym
 }
 
 static void
-create_lv_sym_table(mrc_ccontext *c, const mrc_irep *irep, mrc_sym **syms, uint32_t *syms_len)
+create_lv_sym_table(mrc_ccontext *c, const mrc_irep *irep, mrc_symtab *syms)
 {
   /* Match the non-NULL zero-length marker inserted by the code generator;
      a NULL argument here is undefined behavior (memcmp nonnull) that clang
      miscompiles. */
   pm_constant_id_t null_mark = pm_constant_pool_find(&c->p->constant_pool, (const uint8_t *)"", 0);
 
-  if (*syms == NULL) {
-    *syms = (mrc_sym*)mrc_malloc(c, sizeof(mrc_sym) * 1);
-  }
-
   for (int i = 0; i + 1 < irep->nlocals; i++) {
     mrc_sym const name = irep->lv[i];
     if (name == 0 || name == null_mark) continue;
-    if (find_filename_index(*syms, *syms_len, name) != -1) continue;
-
-    ++(*syms_len);
-    *syms = (mrc_sym*)mrc_realloc(c, *syms, sizeof(mrc_sym) * (*syms_len));
-    (*syms)[*syms_len - 1] = name;
+    mrc_symtab_add(c, syms, name, NULL);
   }
 
   for (int i = 0; i < irep->rlen; i++) {
-    create_lv_sym_table(c, irep->reps[i], syms, syms_len);
+    create_lv_sym_table(c, irep->reps[i], syms);
   }
 }
 
 static int
-write_lv_sym_table(mrc_ccontext *c, uint8_t **start, mrc_sym const *syms, uint32_t syms_len)
+write_lv_sym_table(mrc_ccontext *c, uint8_t **start, const mrc_symtab *syms)
 {
   uint8_t *cur = *start;
   const char *str;
   mrc_int str_len;
 
-  cur += mrc_uint32_to_bin(syms_len, cur);
+  cur += mrc_uint32_to_bin(syms->len, cur);
 
-  for (uint32_t i = 0; i < syms_len; i++) {
-    str = mrc_sym_name_len(c, syms[i], &str_len);
+  for (uint32_t i = 0; i < syms->len; i++) {
+    str = mrc_sym_name_len(c, syms->syms[i], &str_len);
     cur += mrc_uint16_to_bin((uint16_t)str_len, cur);
     memcpy(cur, str, str_len);
     cur += str_len;
@@ -645,7 +937,7 @@ write_lv_sym_table(mrc_ccontext *c, uint8_t **start, mrc_sym const *syms, uint32
 }
 
 static int
-write_lv_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t **start, mrc_sym const *syms, uint32_t syms_len)
+write_lv_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t **start, const mrc_symtab *syms)
 {
   uint8_t *cur = *start;
 
@@ -659,7 +951,7 @@ write_lv_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t **start, mrc_sym
       cur += mrc_uint16_to_bin(RITE_LV_NULL_MARK, cur);
     }
     else {
-      int const sym_idx = find_filename_index(syms, syms_len, irep->lv[i]);
+      int const sym_idx = mrc_symtab_find(syms, irep->lv[i]);
       mrc_assert(sym_idx != -1); /* local variable name must be in syms */
 
       cur += mrc_uint16_to_bin(sym_idx, cur);
@@ -667,7 +959,7 @@ write_lv_record(mrc_ccontext *c, const mrc_irep *irep, uint8_t **start, mrc_sym
   }
 
   for (int i = 0; i < irep->rlen; i++) {
-    write_lv_record(c, irep->reps[i], &cur, syms, syms_len);
+    write_lv_record(c, irep->reps[i], &cur, syms);
   }
 
   *start = cur;
@@ -688,13 +980,13 @@ get_lv_record_size(mrc_ccontext *c, const mrc_irep *irep)
 }
 
 static size_t
-get_lv_section_size(mrc_ccontext *c, const mrc_irep *irep, mrc_sym const *syms, uint32_t syms_len)
+get_lv_section_size(mrc_ccontext *c, const mrc_irep *irep, const mrc_symtab *syms)
 {
   size_t ret = sizeof(uint32_t);      /* syms_len */
-  ret += sizeof(uint16_t) * syms_len; /* symbol name lengths */
-  for (uint32_t i = 0; i < syms_len; i++) {
+  ret += sizeof(uint16_t) * syms->len; /* symbol name lengths */
+  for (uint32_t i = 0; i < syms->len; i++) {
     mrc_int str_len;
-    mrc_sym_name_len(c, syms[i], &str_len);
+    mrc_sym_name_len(c, syms->syms[i], &str_len);
     ret += str_len;
   }
 
@@ -704,7 +996,7 @@ get_lv_section_size(mrc_ccontext *c, const mrc_irep *irep, mrc_sym const *syms,
 }
 
 static int
-write_section_lv(mrc_ccontext *c, const mrc_irep *irep, uint8_t *start, mrc_sym const *syms, uint32_t const syms_len)
+write_section_lv(mrc_ccontext *c, const mrc_irep *irep, uint8_t *start, const mrc_symtab *syms)
 {
   uint8_t *cur = start;
   struct rite_section_lv_header *header;
@@ -718,12 +1010,12 @@ write_section_lv(mrc_ccontext *c, const mrc_irep *irep, uint8_t *start, mrc_sym
   header = (struct rite_section_lv_header*)cur;
   cur += sizeof(struct rite_section_lv_header);
 
-  result = write_lv_sym_table(c, &cur, syms, syms_len);
+  result = write_lv_sym_table(c, &cur, syms);
   if (result != MRC_DUMP_OK) {
     goto lv_section_exit;
   }
 
-  result = write_lv_record(c, irep, &cur, syms, syms_len);
+  result = write_lv_record(c, irep, &cur, syms);
   if (result != MRC_DUMP_OK) {
     goto lv_section_exit;
   }
@@ -745,7 +1037,9 @@ write_rite_binary_header(mrc_ccontext *c, size_t binary_size, uint8_t *bin, uint
 
   memcpy(header->binary_ident, RITE_BINARY_IDENT, sizeof(header->binary_ident));
   memcpy(header->major_version, RITE_BINARY_MAJOR_VER, sizeof(header->major_version));
-  memcpy(header->minor_version, RITE_BINARY_MINOR_VER, sizeof(header->minor_version));
+  memcpy(header->minor_version,
+         (flags & (MRC_DUMP_SYMTAB|MRC_DUMP_STRTAB|MRC_DUMP_ALIGNED)) ? RITE_BINARY_MINOR_VER_EXT : RITE_BINARY_MINOR_VER,
+         sizeof(header->minor_version));
   memcpy(header->compiler_name, RITE_COMPILER_NAME, sizeof(header->compiler_name));
   memcpy(header->compiler_version, RITE_COMPILER_VERSION, sizeof(header->compiler_version));
   mrc_assert(binary_size <= UINT32_MAX);
@@ -778,36 +1072,65 @@ lv_defined_p(const mrc_irep *irep)
   return FALSE;
 }
 
-int
-mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bin, size_t *bin_size)
+static int
+dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bin, size_t *bin_size)
 {
   int result = MRC_DUMP_GENERAL_FAILURE;
   size_t malloc_size;
   size_t section_irep_size;
   size_t section_lineno_size = 0, section_lv_size = 0;
+  size_t section_symtab_size = 0, section_strtab_size = 0;
   uint8_t *cur = NULL;
   mrc_bool const debug_info_defined = debug_info_defined_p(irep), lv_defined = lv_defined_p(irep);
-  mrc_sym *lv_syms = NULL; uint32_t lv_syms_len = 0;
-  mrc_sym *filenames = NULL; uint16_t filenames_len = 0;
+  mrc_symtab lv_syms = { 0 };
+  mrc_symtab filenames = { 0 };
+  mrc_symtab global_syms = { 0 };
+  lit_str_table lit_strs = { 0 };
+  dump_tables tables = { NULL, NULL, FALSE, 0, NULL };
+  irep_record_sizes record_sizes = { NULL, 0, 0 };
 
   if (c == NULL) {
     *bin = NULL;
     return MRC_DUMP_GENERAL_FAILURE;
   }
 
+  if (flags & MRC_DUMP_SYMTAB) {
+    create_global_sym_table(c, irep, &global_syms);
+    if (global_syms.len >= RITE_SYMTAB_NULL_INDEX) {
+      /* too many symbols for 16-bit indexes; keep the names in each irep */
+      flags &= ~MRC_DUMP_SYMTAB;
+    }
+    else {
+      section_symtab_size = get_symtab_section_size(c, &global_syms);
+      tables.syms = &global_syms;
+    }
+  }
+  if (flags & MRC_DUMP_STRTAB) {
+    create_lit_str_table(c, irep, &lit_strs);
+    section_strtab_size = get_strtab_section_size(c, &lit_strs);
+    tables.strs = &lit_strs;
+  }
+  tables.aligned = (flags & MRC_DUMP_ALIGNED) != 0;
+  tables.records_offset = sizeof(struct rite_binary_header) +
+                          section_symtab_size + section_strtab_size +
+                          sizeof(struct rite_section_irep_header);
+
+  if (irep_record_sizes_init(c, irep, &tables, &record_sizes) != MRC_DUMP_OK) {
+    mrc_symtab_free(c, &global_syms);
+    lit_str_table_free(c, &lit_strs);
+    *bin = NULL;
+    return MRC_DUMP_GENERAL_FAILURE;
+  }
   section_irep_size = sizeof(struct rite_section_irep_header);
-  section_irep_size += get_irep_record_size(c, irep);
+  section_irep_size += record_sizes.total;
 
   /* DEBUG section size */
   if (flags & MRC_DUMP_DEBUG_INFO) {
     if (debug_info_defined) {
       section_lineno_size += sizeof(struct rite_section_debug_header);
-      /* filename table */
-      filenames = (mrc_sym*)mrc_malloc(c, sizeof(mrc_sym) + 1);
-
       /* filename table size */
       section_lineno_size += sizeof(uint16_t);
-      section_lineno_size += get_filename_table_size(c, irep, &filenames, &filenames_len);
+      section_lineno_size += get_filename_table_size(c, irep, &filenames);
 
       section_lineno_size += get_debug_record_size(c, irep);
     }
@@ -815,29 +1138,45 @@ mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bi
 
   if (lv_defined) {
     section_lv_size += sizeof(struct rite_section_lv_header);
-    create_lv_sym_table(c, irep, &lv_syms, &lv_syms_len);
-    section_lv_size += get_lv_section_size(c, irep, lv_syms, lv_syms_len);
+    create_lv_sym_table(c, irep, &lv_syms);
+    section_lv_size += get_lv_section_size(c, irep, &lv_syms);
   }
 
-  malloc_size = sizeof(struct rite_binary_header) +
+  malloc_size = sizeof(struct rite_binary_header) + section_symtab_size + section_strtab_size +
                 section_irep_size + section_lineno_size + section_lv_size +
                 sizeof(struct rite_binary_footer);
   cur = *bin = (uint8_t*)mrc_malloc(c, malloc_size);
+  tables.image = *bin;
   cur += sizeof(struct rite_binary_header);
 
-  result = write_section_irep(c, irep, cur, &section_irep_size, flags);
+  if (flags & MRC_DUMP_SYMTAB) {
+    result = write_section_symtab(c, cur, &global_syms);
+    if (result != MRC_DUMP_OK) {
+      goto error_exit;
+    }
+    cur += section_symtab_size;
+  }
+  if (flags & MRC_DUMP_STRTAB) {
+    result = write_section_strtab(c, cur, &lit_strs);
+    if (result != MRC_DUMP_OK) {
+      goto error_exit;
+    }
+    cur += section_strtab_size;
+  }
+
+  result = write_section_irep(c, irep, cur, &section_irep_size, flags, &record_sizes, &tables);
   if (result != MRC_DUMP_OK) {
     goto error_exit;
   }
   cur += section_irep_size;
-  *bin_size = sizeof(struct rite_binary_header) +
+  *bin_size = sizeof(struct rite_binary_header) + section_symtab_size + section_strtab_size +
               section_irep_size + section_lineno_size + section_lv_size +
               sizeof(struct rite_binary_footer);
 
   /* write DEBUG section */
   if (flags & MRC_DUMP_DEBUG_INFO) {
     if (debug_info_defined) {
-      result = write_section_debug(c, irep, cur, filenames, filenames_len);
+      result = write_section_debug(c, irep, cur, &filenames);
       if (result != MRC_DUMP_OK) {
         goto error_exit;
       }
@@ -846,7 +1185,7 @@ mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bi
   }
 
   if (lv_defined) {
-    result = write_section_lv(c, irep, cur, lv_syms, lv_syms_len);
+    result = write_section_lv(c, irep, cur, &lv_syms);
     if (result != MRC_DUMP_OK) {
       goto error_exit;
     }
@@ -855,17 +1194,104 @@ mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bi
 
   write_footer(c, cur);
   write_rite_binary_header(c, *bin_size, *bin, flags);
+  if (c->stats) {
+    c->stats->irep_section_bytes += section_irep_size;
+    c->stats->debug_section_bytes += section_lineno_size;
+    c->stats->lv_section_bytes += section_lv_size;
+    c->stats->symtab_section_bytes += section_symtab_size;
+    c->stats->strtab_section_bytes += section_strtab_size;
+  }
 
 error_exit:
   if (result != MRC_DUMP_OK) {
     mrc_free(c, *bin);
     *bin = NULL;
   }
-  mrc_free(c, lv_syms);
-  mrc_free(c, filenames);
+  mrc_symtab_free(c, &lv_syms);
+  mrc_symtab_free(c, &filenames);
+  mrc_symtab_free(c, &global_syms);
+  lit_str_table_free(c, &lit_strs);
+  mrc_free(c, record_sizes.sizes);
   return result;
 }
 
+int
+mrc_dump_irep(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, uint8_t **bin, size_t *bin_size)
+{
+  if (c == NULL || (!c->stats && !c->trace)) return dump_irep(c, irep, flags, bin, bin_size);
+
+  mrc_trace_begin(c, "dump", NULL, 0);
+  uint64_t start = c->stats ? mrc_stats_clock() : 0;
+  uint64_t allocs, alloc_bytes, allocs1, alloc_bytes1, live, live1, peak;
+  mrc_stats_allocs(&allocs, &alloc_bytes);
+  mrc_stats_live(&live, &peak);
+  int result = dump_irep(c, irep, flags, bin, bin_size);
+  if (c->stats) {
+    c->stats->dump_ns += mrc_stats_clock() - start;
+    mrc_stats_allocs(&allocs1, &alloc_bytes1);
+    c->stats->dump_allocs += allocs1 - allocs;
+    c->stats->dump_alloc_bytes += alloc_bytes1 - alloc_bytes;
+    mrc_stats_live(&live1, &peak);
+    if (peak - live > c->stats->dump_peak_bytes) c->stats->dump_peak_bytes = peak - live;
+    if (result == MRC_DUMP_OK) c->stats->dump_bytes += *bin_size;
+  }
+  mrc_trace_end(c, "dump");
+  return result;
+}
+
+int
+mrc_dump_strip(mrc_ccontext *c, const uint8_t *bin, size_t bin_size, uint8_t **out, size_t *out_size)
+{
+  const struct rite_binary_header *header = (const struct rite_binary_header*)bin;
+  size_t size, pos, out_pos;
+  uint8_t *dst;
+
+  *out = NULL;
+  *out_size = 0;
+  if (c == NULL || bin == NULL || bin_size < sizeof(struct rite_binary_header)) {
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+  if (memcmp(header->binary_ident, RITE_BINARY_IDENT, sizeof(header->binary_ident)) != 0 ||
+      memcmp(header->major_version, RITE_BINARY_MAJOR_VER, sizeof(header->major_version)) != 0) {
+    return MRC_DUMP_INVALID_FILE_HEADER;
+  }
+  size = mrc_bin_to_uint32(header->binary_size);
+  if (size < sizeof(struct rite_binary_header) || bin_size < size) {
+    return MRC_DUMP_READ_FAULT;
+  }
+
+  dst = (uint8_t*)mrc_malloc(c, size);
+  if (dst == NULL) {
+    return MRC_DUMP_GENERAL_FAILURE;
+  }
+  memcpy(dst, bin, sizeof(struct rite_binary_header));
+  pos = out_pos = sizeof(struct rite_binary_header);
+  for (;;) {
+    const struct rite_section_header *section = (const struct rite_section_header*)(bin + pos);
+    size_t section_size;
+
+    if (size - pos < sizeof(struct rite_section_header)) goto read_fault;
+    section_size = mrc_bin_to_uint32(section->section_size);
+    if (section_size < sizeof(struct rite_section_header) || size - pos < section_size) goto read_fault;
+
+    if (memcmp(section->section_ident, RITE_SECTION_DEBUG_IDENT, sizeof(section->section_ident)) != 0 &&
+        memcmp(section->section_ident, RITE_SECTION_LV_IDENT, sizeof(section->section_ident)) != 0) {
+      memcpy(dst + out_pos, section, section_size);
+      out_pos += section_size;
+    }
+    pos += section_size;
+    if (memcmp(section->section_ident, RITE_BINARY_EOF, sizeof(section->section_ident)) == 0) break;
+  }
+  mrc_uint32_to_bin((uint32_t)out_pos, ((struct rite_binary_header*)dst)->binary_size);
+  *out = dst;
+  *out_size = out_pos;
+  return MRC_DUMP_OK;
+
+read_fault:
+  mrc_free(c, dst);
+  return MRC_DUMP_READ_FAULT;
+}
+
 #ifndef MRC_NO_STDIO
 
 int
@@ -890,50 +1316,274 @@ mrc_dump_irep_binary(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE*
   return result;
 }
 
+/* Output of the C dumpers goes through a fixed buffer that is flushed with
+   one fwrite() per CFUNC_BUF_SIZE bytes, instead of one stdio call per byte
+   of the binary. */
+#define CFUNC_BUF_SIZE 4096
+
+typedef struct cfunc_writer {
+  FILE *fp;
+  size_t len;
+  mrc_bool fault;
+  char buf[CFUNC_BUF_SIZE];
+} cfunc_writer;
+
+static void
+cfunc_flush(cfunc_writer *w)
+{
+  if (w->len > 0 && !w->fault) {
+    if (fwrite(w->buf, 1, w->len, w->fp) != w->len) {
+      w->fault = TRUE;
+    }
+  }
+  w->len = 0;
+}
+
+/* reserve room for at least n bytes (n <= CFUNC_BUF_SIZE) */
+static char*
+cfunc_reserve(cfunc_writer *w, size_t n)
+{
+  if (w->len + n > CFUNC_BUF_SIZE) {
+    cfunc_flush(w);
+  }
+  return w->buf + w->len;
+}
+
+static void
+cfunc_puts(cfunc_writer *w, const char *str)
+{
+  size_t len = strlen(str);
+
+  if (len > CFUNC_BUF_SIZE) {
+    cfunc_flush(w);
+    if (!w->fault && fwrite(str, 1, len, w->fp) != len) {
+      w->fault = TRUE;
+    }
+    return;
+  }
+  memcpy(cfunc_reserve(w, len), str, len);
+  w->len += len;
+}
+
+static const char cfunc_hex_digits[] = "0123456789abcdef";
+
+/* `0x%02x,` per byte, 16 bytes per line */
+static void
+cfunc_write_array(cfunc_writer *w, const uint8_t *bin, size_t bin_size)
+{
+  for (size_t i = 0; i < bin_size; i++) {
+    char *p = cfunc_reserve(w, 6);
+    char *start = p;
+
+    if (i % 16 == 0) *p++ = '\n';
+    *p++ = '0';
+    *p++ = 'x';
+    *p++ = cfunc_hex_digits[bin[i] >> 4];
+    *p++ = cfunc_hex_digits[bin[i] & 0xf];
+    *p++ = ',';
+    w->len += p - start;
+  }
+}
+
+/* One string literal split into 64-byte chunks. Printable characters are
+   written as is and everything else as a three digit octal escape, which
+   can never absorb the character that follows it the way \x can. `?` is
+   escaped so that no trigraph is formed. */
+static void
+cfunc_write_string(cfunc_writer *w, const uint8_t *bin, size_t bin_size)
+{
+  for (size_t i = 0; i < bin_size; i++) {
+    char *p = cfunc_reserve(w, 8);
+    char *start = p;
+    uint8_t b = bin[i];
+
+    if (i % 64 == 0) {
+      if (i > 0) *p++ = '"';
+      *p++ = '\n';
+      *p++ = '"';
+    }
+    if (b == '"' || b == '\\' || b == '?') {
+      *p++ = '\\';
+      *p++ = (char)b;
+    }
+    else if (0x20 <= b && b < 0x7f) {
+      *p++ = (char)b;
+    }
+    else {
+      *p++ = '\\';
+      *p++ = (char)('0' + (b >> 6));
+      *p++ = (char)('0' + ((b >> 3) & 7));
+      *p++ = (char)('0' + (b & 7));
+    }
+    w->len += p - start;
+  }
+  if (bin_size > 0) cfunc_puts(w, "\"");
+}
+
+/* a C string literal of `str` for the generated assembler directive: the
+   assembler string is itself quoted, so quotes and backslashes are escaped
+   twice */
+static void
+cfunc_write_incbin_path(cfunc_writer *w, const char *str)
+{
+  for (; *str; str++) {
+    char *p = cfunc_reserve(w, 4);
+    char *start = p;
+
+    if (*str == '"' || *str == '\\') {
+      *p++ = '\\';
+      *p++ = '\\';
+      *p++ = '\\';
+    }
+    *p++ = *str;
+    w->len += p - start;
+  }
+}
+
+static int
+write_incbin_binary(const char *binpath, const uint8_t *bin, size_t bin_size)
+{
+  FILE *bfp = fopen(binpath, "wb");
+  int result = MRC_DUMP_OK;
+
+  if (bfp == NULL) {
+    return MRC_DUMP_WRITE_FAULT;
+  }
+  if (fwrite(bin, 1, bin_size, bfp) != bin_size) {
+    result = MRC_DUMP_WRITE_FAULT;
+  }
+  if (fclose(bfp) != 0) {
+    result = MRC_DUMP_WRITE_FAULT;
+  }
+  return result;
+}
+
 int
 mrc_dump_irep_cfunc(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *initname)
+{
+  return mrc_dump_irep_cfunc_format(c, irep, flags, fp, initname, MRC_DUMP_CFUNC_ARRAY, NULL);
+}
+
+int
+mrc_dump_irep_cfunc_format(mrc_ccontext *c, const mrc_irep *irep, uint8_t flags, FILE *fp, const char *initname, int format, const char *binpath)
 {
   uint8_t *bin = NULL;
+  cfunc_writer *w;
+  const char *linkage = (flags & MRC_DUMP_STATIC) ? "static"
+                                                  : "#ifdef __cplusplus\n"
+                                                    "extern\n"
+                                                    "#endif";
 
   if (fp == NULL || initname == NULL || initname[0] == '\0') {
     return MRC_DUMP_INVALID_ARGUMENT;
   }
-  size_t bin_size, bin_idx = 0;
+  if (format == MRC_DUMP_CFUNC_INCBIN && (binpath == NULL || binpath[0] == '\0')) {
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+  if (format != MRC_DUMP_CFUNC_ARRAY && format != MRC_DUMP_CFUNC_STRING &&
+      format != MRC_DUMP_CFUNC_INCBIN) {
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+  size_t bin_size;
   int result = mrc_dump_irep(c, irep, flags, &bin, &bin_size);
-  if (result == MRC_DUMP_OK) {
-    if (fprintf(fp, "#include <stdint.h>\n") < 0) { /* for uint8_t under at least Darwin */
-      mrc_free(c, bin);
-      return MRC_DUMP_WRITE_FAULT;
-    }
-    if (fprintf(fp,
-          "%s\n"
-          "const uint8_t %s[] = {",
-          (flags & MRC_DUMP_STATIC) ? "static"
-                                    : "#ifdef __cplusplus\n"
-                                      "extern\n"
-                                      "#endif",
-          initname) < 0) {
-      mrc_free(c, bin);
-      return MRC_DUMP_WRITE_FAULT;
-    }
-    while (bin_idx < bin_size) {
-      if (bin_idx % 16 == 0) {
-        if (fputs("\n", fp) == EOF) {
-          mrc_free(c, bin);
-          return MRC_DUMP_WRITE_FAULT;
-        }
-      }
-      if (fprintf(fp, "0x%02x,", bin[bin_idx++]) < 0) {
-        mrc_free(c, bin);
-        return MRC_DUMP_WRITE_FAULT;
-      }
-    }
-    if (fputs("\n};\n", fp) == EOF) {
-      mrc_free(c, bin);
-      return MRC_DUMP_WRITE_FAULT;
-    }
+  if (result != MRC_DUMP_OK) {
+    return result;
+  }
+  w = (cfunc_writer*)mrc_malloc(c, sizeof(cfunc_writer));
+  if (w == NULL) {
+    mrc_free(c, bin);
+    return MRC_DUMP_GENERAL_FAILURE;
+  }
+  w->fp = fp;
+  w->len = 0;
+  w->fault = FALSE;
+
+  cfunc_puts(w, "#include <stdint.h>\n"); /* for uint8_t under at least Darwin */
+  /* an aligned layout is only aligned if the image itself is */
+  const char *align = "";
+  if ((flags & MRC_DUMP_ALIGNED) && format != MRC_DUMP_CFUNC_INCBIN) {
+    cfunc_puts(w, "#if defined(__GNUC__)\n"
+                  "#define mrb_IMAGE_ALIGN __attribute__((aligned(8)))\n"
+                  "#elif defined(_MSC_VER)\n"
+                  "#define mrb_IMAGE_ALIGN __declspec(align(8))\n"
+                  "#else\n"
+                  "#define mrb_IMAGE_ALIGN\n"
+                  "#endif\n");
+    align = "mrb_IMAGE_ALIGN ";
+  }
+  switch (format) {
+  case MRC_DUMP_CFUNC_ARRAY:
+    cfunc_puts(w, linkage);
+    cfunc_puts(w, "\n");
+    cfunc_puts(w, align);
+    cfunc_puts(w, "const uint8_t ");
+    cfunc_puts(w, initname);
+    cfunc_puts(w, "[] = {");
+    cfunc_write_array(w, bin, bin_size);
+    cfunc_puts(w, "\n};\n");
+    break;
+
+  case MRC_DUMP_CFUNC_STRING:
+    /* the literal carries an extra terminating NUL the loader never reads */
+    cfunc_puts(w, linkage);
+    cfunc_puts(w, "\n");
+    cfunc_puts(w, align);
+    cfunc_puts(w, "const uint8_t ");
+    cfunc_puts(w, initname);
+    cfunc_puts(w, "[] =");
+    if (bin_size == 0) cfunc_puts(w, " \"\"");
+    cfunc_write_string(w, bin, bin_size);
+    cfunc_puts(w, ";\n");
+    break;
+
+  case MRC_DUMP_CFUNC_INCBIN:
+    /* The binary goes to its own file and the assembler pulls it in, so the
+       C compiler never sees the bytes. The symbol is always global: a
+       top-level asm label cannot be given internal linkage portably. GNU
+       assemblers only (gcc, clang). */
+    result = write_incbin_binary(binpath, bin, bin_size);
+    cfunc_puts(w, "#ifndef __USER_LABEL_PREFIX__\n"
+                  "#define __USER_LABEL_PREFIX__\n"
+                  "#endif\n"
+                  "#define mrb_INCBIN_STR0(x) #x\n"
+                  "#define mrb_INCBIN_STR(x) mrb_INCBIN_STR0(x)\n"
+                  "#define mrb_INCBIN_SYM(name) mrb_INCBIN_STR(__USER_LABEL_PREFIX__) #name\n"
+                  "#if defined(__APPLE__)\n"
+                  "#define mrb_INCBIN_PUSH \".const_data\\n\"\n"
+                  "#define mrb_INCBIN_POP \".text\\n\"\n"
+                  "#else\n"
+                  "#define mrb_INCBIN_PUSH \".pushsection .rodata\\n\"\n"
+                  "#define mrb_INCBIN_POP \".popsection\\n\"\n"
+                  "#endif\n"
+                  "__asm__(mrb_INCBIN_PUSH\n"
+                  "        \".globl \" mrb_INCBIN_SYM(");
+    cfunc_puts(w, initname);
+    cfunc_puts(w, ") \"\\n\"\n");
+    cfunc_puts(w, (flags & MRC_DUMP_ALIGNED) ? "        \".balign 8\\n\"\n"
+                                             : "        \".balign 4\\n\"\n");
+    cfunc_puts(w, "        mrb_INCBIN_SYM(");
+    cfunc_puts(w, initname);
+    cfunc_puts(w, ") \":\\n\"\n"
+                  "        \".incbin \\\"");
+    cfunc_write_incbin_path(w, binpath);
+    cfunc_puts(w, "\\\"\\n\"\n"
+                  "        mrb_INCBIN_POP);\n"
+                  "#ifdef __cplusplus\n"
+                  "extern \"C\"\n"
+                  "#else\n"
+                  "extern\n"
+                  "#endif\n"
+                  "const uint8_t ");
+    cfunc_puts(w, initname);
+    cfunc_puts(w, "[];\n");
+    break;
+  }
+  cfunc_flush(w);
+  if (result == MRC_DUMP_OK && w->fault) {
+    result = MRC_DUMP_WRITE_FAULT;
   }
 
+  mrc_free(c, w);
   mrc_free(c, bin);
   return result;
 }
@@ -1,6 +1,7 @@
 #include "../include/mrc_irep.h"
 #include "../include/mrc_debug.h"
 #include "../include/mrc_irep_pool_type.h"
+#include "../include/mrc_opcode.h"
 
 void
 mrc_irep_remove_lv(mrc_ccontext *c, mrc_irep *irep)
@@ -18,6 +19,169 @@ mrc_irep_remove_lv(mrc_ccontext *c, mrc_irep *irep)
   }
 }
 
+/* operand layouts, as in mrc_ops.h */
+enum insn_format { FMT_Z, FMT_B, FMT_BB, FMT_BBB, FMT_BS, FMT_BSS, FMT_S, FMT_W };
+
+static const uint8_t insn_format[] = {
+#define OPCODE(_,f) FMT_ ## f,
+#include "../include/mrc_ops.h"
+#undef OPCODE
+};
+
+#define REF_A_POOL 1
+#define REF_B_POOL 2
+#define REF_A_SYM  4
+#define REF_B_SYM  8
+
+/* the operands of `insn` that index the pool or the symbols */
+static int
+insn_refs(uint8_t insn)
+{
+  switch (insn) {
+  case OP_LOADL: case OP_SYMBOL: case OP_STRING:
+    return REF_B_POOL;
+  case OP_ERR:
+    return REF_A_POOL;
+  case OP_LOADSYM:
+  case OP_GETGV: case OP_SETGV: case OP_GETSV: case OP_SETSV:
+  case OP_GETIV: case OP_SETIV: case OP_GETCV: case OP_SETCV:
+  case OP_GETCONST: case OP_SETCONST: case OP_GETMCNST: case OP_SETMCNST:
+  case OP_SSEND: case OP_SSEND0: case OP_SSENDB:
+  case OP_SEND: case OP_SEND0: case OP_SENDB:
+  case OP_KEY_P: case OP_KARG:
+  case OP_CLASS: case OP_MODULE: case OP_DEF: case OP_TDEF: case OP_SDEF:
+    return REF_B_SYM;
+  case OP_ALIAS:
+    return REF_A_SYM | REF_B_SYM;
+  case OP_UNDEF:
+    return REF_A_SYM;
+  default:
+    return 0;
+  }
+}
+
+/* mark the index an operand holds (`map` entry set to 1), or replace it
+   with its new index from `map` */
+static void
+strip_ref(mrc_code *p, mrc_bool wide, uint16_t *map, uint16_t len, mrc_bool rewrite)
+{
+  uint16_t idx = wide ? (uint16_t)(p[0] << 8 | p[1]) : p[0];
+
+  if (idx >= len) return;
+  if (!rewrite) {
+    map[idx] = 1;
+    return;
+  }
+  idx = map[idx];
+  if (wide) {
+    p[0] = (mrc_code)(idx >> 8);
+    p[1] = (mrc_code)(idx & 0xff);
+  }
+  else {
+    p[0] = (mrc_code)idx;
+  }
+}
+
+static void
+strip_refs(mrc_irep *irep, uint16_t *pool_map, uint16_t *sym_map, mrc_bool rewrite)
+{
+  mrc_code *i = (mrc_code *)irep->iseq;
+  mrc_code *end = i + irep->ilen;
+
+  while (i < end) {
+    int ext = 0;
+    uint8_t insn;
+    uint32_t alen = 0, blen = 0, rest = 0;
+    int refs;
+
+    switch (*i) {
+    case OP_EXT1: ext = 1; i++; break;
+    case OP_EXT2: ext = 2; i++; break;
+    case OP_EXT3: ext = 3; i++; break;
+    default: break;
+    }
+    insn = *i++;
+    switch (insn_format[insn]) {
+    case FMT_B:   alen = (ext & 1) ? 2 : 1; break;
+    case FMT_BB:  alen = (ext & 1) ? 2 : 1; blen = (ext & 2) ? 2 : 1; break;
+    case FMT_BBB: alen = (ext & 1) ? 2 : 1; blen = (ext & 2) ? 2 : 1; rest = 1; break;
+    case FMT_BS:  alen = (ext & 1) ? 2 : 1; rest = 2; break;
+    case FMT_BSS: alen = (ext & 1) ? 2 : 1; rest = 4; break;
+    case FMT_S:   rest = 2; break;
+    case FMT_W:   rest = 3; break;
+    default: break;
+    }
+    refs = insn_refs(insn);
+    if (refs & REF_A_POOL) strip_ref(i, alen == 2, pool_map, irep->plen, rewrite);
+    if (refs & REF_A_SYM) strip_ref(i, alen == 2, sym_map, irep->slen, rewrite);
+    if (refs & REF_B_POOL) strip_ref(i + alen, blen == 2, pool_map, irep->plen, rewrite);
+    if (refs & REF_B_SYM) strip_ref(i + alen, blen == 2, sym_map, irep->slen, rewrite);
+    i += alen + blen + rest;
+  }
+}
+
+/* Drop the pool entries and symbols no instruction refers to and renumber
+   the operands. Codegen leaves such entries behind when the peephole
+   rewinds an instruction, e.g. a LOADL folded into a constant. Indices only
+   shrink, so every operand keeps its width. */
+static void
+strip_unused_refs(mrc_ccontext *c, mrc_irep *irep)
+{
+  mrc_pool_value *pool = (mrc_pool_value *)irep->pool;
+  mrc_sym *syms = (mrc_sym *)irep->syms;
+  uint16_t *pool_map, *sym_map;
+  uint16_t np = 0, ns = 0;
+  int i;
+
+  /* an iseq that is not ours (read in place) cannot be rewritten */
+  if (irep->flags & MRC_ISEQ_NO_FREE) return;
+  if (irep->plen == 0 && irep->slen == 0) return;
+  pool_map = (uint16_t *)mrc_calloc(c, (size_t)irep->plen + irep->slen, sizeof(uint16_t));
+  if (pool_map == NULL) return;
+  sym_map = pool_map + irep->plen;
+  strip_refs(irep, pool_map, sym_map, FALSE);
+  for (i = 0; i < irep->plen; i++) {
+    if (pool_map[i]) {
+      pool[np] = pool[i];
+      pool_map[i] = np++;
+    }
+    else if ((pool[i].tt & 3) == IREP_TT_STR || pool[i].tt == IREP_TT_BIGINT) {
+      mrc_free(c, (void*)pool[i].u.str);
+    }
+  }
+  for (i = 0; i < irep->slen; i++) {
+    if (sym_map[i]) {
+      syms[ns] = syms[i];
+      sym_map[i] = ns++;
+    }
+  }
+  if (np < irep->plen || ns < irep->slen) {
+    strip_refs(irep, pool_map, sym_map, TRUE);
+    irep->plen = np;
+    irep->slen = ns;
+  }
+  mrc_free(c, pool_map);
+}
+
+void
+mrc_irep_strip(mrc_ccontext *c, mrc_irep *irep)
+{
+  int i;
+
+  if (irep->flags & MRC_IREP_NO_FREE) return;
+  strip_unused_refs(c, irep);
+  mrc_debug_info_free(c, irep->debug_info);
+  irep->debug_info = NULL;
+  if (irep->lv) {
+    mrc_free(c, (void*)irep->lv);
+    irep->lv = NULL;
+  }
+  if (!irep->reps) return;
+  for (i = 0; i < irep->rlen; i++) {
+    mrc_irep_strip(c, (mrc_irep*)irep->reps[i]);
+  }
+}
+
 void
 mrc_irep_free(mrc_ccontext *c, mrc_irep *irep)
 {
@@ -0,0 +1,16 @@
+#include "../include/mrc_json.h"
+
+#ifndef MRC_NO_STDIO
+MRC_API void
+mrc_json_string(const char *s, size_t len, FILE *out)
+{
+  fputc('"', out);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char ch = (unsigned char)s[i];
+    if (ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+    else if (ch < 0x20) fprintf(out, "\\u%04x", ch);
+    else fputc(ch, out);
+  }
+  fputc('"', out);
+}
+#endif // MRC_NO_STDIO
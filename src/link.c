@@ -0,0 +1,215 @@
+/*
+** link.c - merge several compiled programs into one irep tree
+**
+** See Copyright Notice in mruby.h
+*/
+
+#include <string.h>
+#include "../include/mrc_ccontext.h"
+#include "../include/mrc_irep.h"
+#include "../include/mrc_dump.h"
+#include "../include/mrc_debug.h"
+#include "../include/mrc_opcode.h"
+
+/* The root irep turns each program into a block and calls it at once:
+ *
+ *   BLOCK R1 I(i)     (EXT2 prefixed past 255 programs)
+ *   SEND  R1 :call 0
+ *   ...
+ *   STOP
+ *
+ * so every program still runs with the top-level self, in the given order.
+ */
+
+static size_t
+link_iseq_size(uint16_t n)
+{
+  size_t size = 0;
+
+  for (uint16_t i = 0; i < n; i++) {
+    size += (i > 0xff ? 5 : 3) + 4;
+  }
+  return size + 1;
+}
+
+static mrc_code*
+link_iseq(mrc_ccontext *c, uint16_t n)
+{
+  mrc_code *iseq = (mrc_code *)mrc_malloc(c, link_iseq_size(n));
+  mrc_code *p = iseq;
+
+  if (iseq == NULL) return NULL;
+  for (uint16_t i = 0; i < n; i++) {
+    if (i > 0xff) {
+      *p++ = OP_EXT2;
+      *p++ = OP_BLOCK;
+      *p++ = 1;
+      p += mrc_uint16_to_bin(i, p);
+    }
+    else {
+      *p++ = OP_BLOCK;
+      *p++ = 1;
+      *p++ = (mrc_code)i;
+    }
+    *p++ = OP_SEND;
+    *p++ = 1;
+    *p++ = 0;                   /* syms[0] = :call */
+    *p++ = 0;
+  }
+  *p = OP_STOP;
+  return iseq;
+}
+
+static mrc_bool
+all_debug_info_p(mrc_irep **ireps, uint16_t n)
+{
+  for (uint16_t i = 0; i < n; i++) {
+    if (ireps[i]->debug_info == NULL || ireps[i]->debug_info->flen == 0) return FALSE;
+  }
+  return TRUE;
+}
+
+/* the whole root body is on line 1 of the first program's file */
+static int
+link_debug_info(mrc_ccontext *c, mrc_irep *root, mrc_sym filename)
+{
+  static const uint8_t line1[] = { 0x00, 0x01 };  /* pos +0, line +1 */
+  mrc_irep_debug_info *d = mrc_debug_info_alloc(c, root);
+  mrc_irep_debug_info_file *f;
+  uint8_t *packed;
+
+  d->pc_count = root->ilen;
+  d->files = (mrc_irep_debug_info_file **)mrc_malloc(c, sizeof(mrc_irep_debug_info_file *));
+  f = (mrc_irep_debug_info_file *)mrc_calloc(c, 1, sizeof(mrc_irep_debug_info_file));
+  packed = (uint8_t *)mrc_malloc(c, sizeof(line1));
+  if (d->files == NULL || f == NULL || packed == NULL) {
+    mrc_free(c, f);
+    mrc_free(c, packed);
+    return MRC_DUMP_GENERAL_FAILURE;
+  }
+  memcpy(packed, line1, sizeof(line1));
+  f->start_pos = 0;
+  f->filename_sym = filename;
+  f->line_type = mrc_debug_line_packed_map;
+  f->line_entry_count = sizeof(line1);
+  f->lines.packed_map = packed;
+  d->files[d->flen++] = f;
+  return MRC_DUMP_OK;
+}
+
+/* the LVAR section is written for all ireps or none, and its writer reads
+   lv of every irep with locals; give empty tables to those without */
+static int
+fill_lv(mrc_ccontext *c, mrc_irep *irep)
+{
+  if (irep->nlocals > 1 && irep->lv == NULL) {
+    irep->lv = (mrc_sym *)mrc_calloc(c, irep->nlocals - 1, sizeof(mrc_sym));
+    if (irep->lv == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  }
+  for (int i = 0; i < irep->rlen; i++) {
+    int result = fill_lv(c, (mrc_irep *)irep->reps[i]);
+    if (result != MRC_DUMP_OK) return result;
+  }
+  return MRC_DUMP_OK;
+}
+
+static mrc_bool
+any_lv_p(const mrc_irep *irep)
+{
+  if (irep->lv) return TRUE;
+  for (int i = 0; i < irep->rlen; i++) {
+    if (any_lv_p(irep->reps[i])) return TRUE;
+  }
+  return FALSE;
+}
+
+int
+mrc_link_irep(mrc_ccontext *c, mrc_irep **ireps, uint16_t n, mrc_irep **root)
+{
+  pm_constant_pool_t *pool;
+  mrc_irep *r;
+  mrc_sym *syms;
+  int result;
+
+  if (root) *root = NULL;
+  if (c == NULL || ireps == NULL || root == NULL || n == 0) {
+    if (c && ireps) {
+      for (uint16_t i = 0; i < n; i++) {
+        if (ireps[i]) mrc_irep_free(c, ireps[i]);
+      }
+      mrc_free(c, ireps);
+    }
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+
+  r = (mrc_irep *)mrc_calloc(c, 1, sizeof(mrc_irep));
+  if (r == NULL) goto failure;
+  r->refcnt = 1;
+  r->nlocals = 1;
+  r->nregs = 3;
+  r->reps = (const mrc_irep * const *)ireps;
+  r->rlen = n;
+
+  syms = (mrc_sym *)mrc_malloc(c, sizeof(mrc_sym));
+  if (syms == NULL) goto failure;
+  pool = &c->p->constant_pool;
+  if (pool->capacity == 0) {
+    pm_constant_pool_init(pool, 64);
+  }
+  syms[0] = pm_constant_pool_insert_constant(pool, (const uint8_t *)"call", 4);
+  r->syms = syms;
+  r->slen = 1;
+
+  r->iseq = link_iseq(c, n);
+  if (r->iseq == NULL) goto failure;
+  r->ilen = (uint32_t)link_iseq_size(n);
+
+  if (all_debug_info_p(ireps, n)) {
+    result = link_debug_info(c, r, ireps[0]->debug_info->files[0]->filename_sym);
+    if (result != MRC_DUMP_OK) goto failure;
+  }
+  if (any_lv_p(r)) {
+    result = fill_lv(c, r);
+    if (result != MRC_DUMP_OK) goto failure;
+  }
+  *root = r;
+  return MRC_DUMP_OK;
+
+failure:
+  if (r) {
+    /* frees the children too */
+    mrc_irep_free(c, r);
+  }
+  else {
+    for (uint16_t i = 0; i < n; i++) {
+      if (ireps[i]) mrc_irep_free(c, ireps[i]);
+    }
+    mrc_free(c, ireps);
+  }
+  return MRC_DUMP_GENERAL_FAILURE;
+}
+
+int
+mrc_link_binaries(mrc_ccontext *c, const uint8_t *const *bins, const size_t *bin_sizes, uint16_t n, mrc_irep **root)
+{
+  mrc_irep **ireps;
+
+  if (root) *root = NULL;
+  if (c == NULL || bins == NULL || bin_sizes == NULL || root == NULL || n == 0) {
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+  ireps = (mrc_irep **)mrc_calloc(c, n, sizeof(mrc_irep *));
+  if (ireps == NULL) return MRC_DUMP_GENERAL_FAILURE;
+
+  for (uint16_t i = 0; i < n; i++) {
+    int result = mrc_read_irep(c, bins[i], bin_sizes[i], &ireps[i]);
+    if (result != MRC_DUMP_OK) {
+      for (uint16_t j = 0; j < i; j++) {
+        mrc_irep_free(c, ireps[j]);
+      }
+      mrc_free(c, ireps);
+      return result;
+    }
+  }
+  return mrc_link_irep(c, ireps, n, root);
+}
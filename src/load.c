@@ -0,0 +1,575 @@
+/*
+** load.c - read a RITE binary back into an mrc_irep tree
+**
+** See Copyright Notice in mruby.h
+*/
+
+#include <string.h>
+#include "../include/mrc_ccontext.h"
+#include "../include/mrc_irep.h"
+#include "../include/mrc_dump.h"
+#include "../include/mrc_debug.h"
+#include "../include/mrc_irep_pool_type.h"
+
+/* Every symbol and filename is interned in the context's constant pool, so a
+   loaded tree can be linked with others and dumped again like a freshly
+   compiled one. Nothing points into the image once loading returns. */
+
+typedef struct load_state {
+  mrc_ccontext *c;
+  const uint8_t *image;         /* start of the image; IRPA padding counts from here */
+  const uint8_t *end;
+  mrc_bool aligned;
+  mrc_sym *syms;                /* SYMT, or NULL */
+  uint16_t syms_len;
+  const uint8_t **strs;         /* STRT entries (length, string, null char), or NULL */
+  uint16_t strs_len;
+} load_state;
+
+#define LOAD_REMAIN(s, p) ((size_t)((s)->end - (p)))
+
+static mrc_sym
+load_sym(mrc_ccontext *c, const uint8_t *name, size_t len)
+{
+  pm_constant_pool_t *pool = &c->p->constant_pool;
+
+  /* a context that never parsed has a zero-capacity pool, which cannot grow */
+  if (pool->capacity == 0) {
+    pm_constant_pool_init(pool, 64);
+  }
+  if (len == 0) {
+    /* same empty-name marker codegen uses; see nsym() */
+    return pm_constant_pool_insert_constant(pool, (const uint8_t *)"", 0);
+  }
+  uint8_t *copy = (uint8_t *)xmalloc(len);
+  memcpy(copy, name, len);
+  return pm_constant_pool_insert_owned(pool, copy, len);
+}
+
+/* a table of (uint16_t length, name[, null char]) entries, as SYMT, DBG and
+   LVAR write them */
+static int
+read_sym_table(load_state *s, const uint8_t **pp, uint32_t len, mrc_bool nul, mrc_sym **symsp)
+{
+  const uint8_t *p = *pp;
+  mrc_sym *syms = (mrc_sym *)mrc_malloc(s->c, sizeof(mrc_sym) * (len ? len : 1));
+
+  if (syms == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  for (uint32_t i = 0; i < len; i++) {
+    if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) goto read_fault;
+    uint16_t slen = mrc_bin_to_uint16(p);
+    p += sizeof(uint16_t);
+    if (LOAD_REMAIN(s, p) < (size_t)slen + (nul ? 1 : 0)) goto read_fault;
+    syms[i] = load_sym(s->c, p, slen);
+    p += slen + (nul ? 1 : 0);
+  }
+  *pp = p;
+  *symsp = syms;
+  return MRC_DUMP_OK;
+
+read_fault:
+  mrc_free(s->c, syms);
+  return MRC_DUMP_READ_FAULT;
+}
+
+static size_t
+load_padding(const load_state *s, const uint8_t *p, size_t align)
+{
+  if (!s->aligned) return 0;
+  size_t pos = (size_t)(p - s->image);
+  return (align - pos % align) % align;
+}
+
+static int
+read_pool(load_state *s, const uint8_t **pp, mrc_irep *irep)
+{
+  const uint8_t *p = *pp;
+  mrc_pool_value *pool;
+  uint16_t plen;
+
+  if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+  plen = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  if (plen == 0) {
+    *pp = p;
+    return MRC_DUMP_OK;
+  }
+  /* zero-filled entries are empty strings; mrc_irep_free() copes with them
+     if reading stops half way */
+  pool = (mrc_pool_value *)mrc_calloc(s->c, plen, sizeof(mrc_pool_value));
+  if (pool == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  irep->pool = pool;
+  irep->plen = plen;
+
+  for (uint16_t i = 0; i < plen; i++) {
+    mrc_pool_value *pv = &pool[i];
+    const uint8_t *str;
+    size_t len;
+
+    if (LOAD_REMAIN(s, p) < sizeof(uint8_t)) return MRC_DUMP_READ_FAULT;
+    switch (*p++) {
+    case IREP_TT_INT32:
+      if (LOAD_REMAIN(s, p) < sizeof(uint32_t)) return MRC_DUMP_READ_FAULT;
+      pv->tt = IREP_TT_INT32;
+      pv->u.i32 = (int32_t)mrc_bin_to_uint32(p);
+      p += sizeof(uint32_t);
+      break;
+
+    case IREP_TT_INT64:
+      p += load_padding(s, p, sizeof(int64_t));
+      if (LOAD_REMAIN(s, p) < sizeof(uint64_t)) return MRC_DUMP_READ_FAULT;
+      pv->tt = IREP_TT_INT64;
+      pv->u.i64 = (int64_t)((uint64_t)mrc_bin_to_uint32(p) << 32 | mrc_bin_to_uint32(p + 4));
+      p += sizeof(uint64_t);
+      break;
+
+    case IREP_TT_FLOAT:
+#ifndef MRC_NO_FLOAT
+      p += load_padding(s, p, sizeof(double));
+      if (LOAD_REMAIN(s, p) < sizeof(double)) return MRC_DUMP_READ_FAULT;
+      {
+        /* IEEE754 binary in little endian; see dump_float() */
+        union {
+          double f;
+          uint8_t s[sizeof(double)];
+        } u;
+        unsigned int one = 1;
+
+        for (size_t b = 0; b < sizeof(double); b++) {
+          u.s[b] = (*(unsigned char*)&one == 1) ? p[b] : p[sizeof(double)-b-1];
+        }
+        pv->tt = IREP_TT_FLOAT;
+        pv->u.f = (mrc_float)u.f;
+      }
+      p += sizeof(double);
+      break;
+#else
+      return MRC_DUMP_INVALID_IREP;
+#endif
+
+    case IREP_TT_BIGINT:
+      if (LOAD_REMAIN(s, p) < 2 || LOAD_REMAIN(s, p) < (size_t)p[0] + 2) return MRC_DUMP_READ_FAULT;
+      {
+        char *buf = (char *)mrc_malloc(s->c, (size_t)p[0] + 3);
+        if (buf == NULL) return MRC_DUMP_GENERAL_FAILURE;
+        memcpy(buf, p, (size_t)p[0] + 2);
+        buf[p[0] + 2] = '\0';
+        pv->tt = IREP_TT_BIGINT;
+        pv->u.str = buf;
+        p += (size_t)p[0] + 2;
+      }
+      break;
+
+    case IREP_TT_SHARED_STR:
+      if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+      {
+        uint16_t idx = mrc_bin_to_uint16(p);
+        if (idx >= s->strs_len) return MRC_DUMP_INVALID_IREP;
+        str = s->strs[idx];
+        p += sizeof(uint16_t);
+      }
+      goto string;
+
+    case IREP_TT_STR:
+    case IREP_TT_SSTR:
+      str = p;
+      if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+      if (LOAD_REMAIN(s, p) < sizeof(uint16_t) + mrc_bin_to_uint16(p) + 1) return MRC_DUMP_READ_FAULT;
+      p += sizeof(uint16_t) + mrc_bin_to_uint16(p) + 1;
+    string:
+      len = mrc_bin_to_uint16(str);
+      {
+        char *buf = (char *)mrc_malloc(s->c, len + 1);
+        if (buf == NULL) return MRC_DUMP_GENERAL_FAILURE;
+        if (len) memcpy(buf, str + sizeof(uint16_t), len);
+        buf[len] = '\0';
+        pv->tt = (uint32_t)(len << 2) | IREP_TT_STR;
+        pv->u.str = buf;
+      }
+      break;
+
+    default:
+      return MRC_DUMP_INVALID_IREP;
+    }
+  }
+  *pp = p;
+  return MRC_DUMP_OK;
+}
+
+static int
+read_syms(load_state *s, const uint8_t **pp, mrc_irep *irep)
+{
+  const uint8_t *p = *pp;
+  mrc_sym *syms;
+  uint16_t slen;
+
+  if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+  slen = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  if (slen == 0) {
+    *pp = p;
+    return MRC_DUMP_OK;
+  }
+  syms = (mrc_sym *)mrc_calloc(s->c, slen, sizeof(mrc_sym));
+  if (syms == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  irep->syms = syms;
+  irep->slen = slen;
+
+  for (uint16_t i = 0; i < slen; i++) {
+    if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+    uint16_t v = mrc_bin_to_uint16(p);
+    p += sizeof(uint16_t);
+    if (s->syms) {
+      if (v == RITE_SYMTAB_NULL_INDEX) continue;
+      if (v >= s->syms_len) return MRC_DUMP_INVALID_IREP;
+      syms[i] = s->syms[v];
+    }
+    else {
+      if (v == MRC_DUMP_NULL_SYM_LEN) continue;
+      if (LOAD_REMAIN(s, p) < (size_t)v + 1) return MRC_DUMP_READ_FAULT;
+      syms[i] = load_sym(s->c, p, v);
+      p += v + 1;
+    }
+  }
+  *pp = p;
+  return MRC_DUMP_OK;
+}
+
+static int
+read_irep_record(load_state *s, const uint8_t **pp, mrc_irep **irepp)
+{
+  const uint8_t *p = *pp;
+  const uint8_t *start = p;
+  mrc_irep *irep;
+  uint32_t record_size;
+  uint16_t rlen, clen;
+  uint32_t ilen;
+  size_t seqlen;
+  int result;
+
+  if (LOAD_REMAIN(s, p) < sizeof(uint32_t) + sizeof(uint16_t) * 3) return MRC_DUMP_READ_FAULT;
+  irep = (mrc_irep *)mrc_calloc(s->c, 1, sizeof(mrc_irep));
+  if (irep == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  *irepp = irep;
+  irep->refcnt = 1;
+
+  record_size = mrc_bin_to_uint32(p);
+  p += sizeof(uint32_t);
+  irep->nlocals = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  irep->nregs = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  rlen = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+
+  /* iseq block */
+  if (LOAD_REMAIN(s, p) < sizeof(uint16_t) + sizeof(uint32_t)) return MRC_DUMP_READ_FAULT;
+  clen = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  ilen = mrc_bin_to_uint32(p);
+  p += sizeof(uint32_t);
+  p += load_padding(s, p, MRC_DUMP_ALIGNMENT);
+  seqlen = (size_t)ilen * sizeof(mrc_code) + (size_t)clen * sizeof(struct mrc_irep_catch_handler);
+  if (LOAD_REMAIN(s, p) < seqlen) return MRC_DUMP_READ_FAULT;
+  {
+    mrc_code *iseq = (mrc_code *)mrc_malloc(s->c, seqlen ? seqlen : 1);
+    if (iseq == NULL) return MRC_DUMP_GENERAL_FAILURE;
+    memcpy(iseq, p, seqlen);
+    irep->iseq = iseq;
+  }
+  irep->ilen = ilen;
+  irep->clen = clen;
+  p += seqlen;
+
+  result = read_pool(s, &p, irep);
+  if (result != MRC_DUMP_OK) return result;
+  result = read_syms(s, &p, irep);
+  if (result != MRC_DUMP_OK) return result;
+  if ((size_t)(p - start) != record_size) return MRC_DUMP_INVALID_IREP;
+
+  if (rlen > 0) {
+    mrc_irep **reps = (mrc_irep **)mrc_calloc(s->c, rlen, sizeof(mrc_irep *));
+    if (reps == NULL) return MRC_DUMP_GENERAL_FAILURE;
+    irep->reps = (const mrc_irep * const *)reps;
+    /* rlen counts the children read so far, so that a partial tree frees */
+    for (uint16_t i = 0; i < rlen; i++) {
+      result = read_irep_record(s, &p, &reps[i]);
+      if (reps[i]) irep->rlen++;
+      if (result != MRC_DUMP_OK) return result;
+    }
+  }
+  *pp = p;
+  return MRC_DUMP_OK;
+}
+
+static int
+read_debug_record(load_state *s, const uint8_t **pp, mrc_irep *irep, const mrc_sym *filenames, uint16_t filenames_len)
+{
+  const uint8_t *p = *pp;
+  const uint8_t *start = p;
+  mrc_irep_debug_info *d;
+  uint32_t record_size;
+  uint16_t flen;
+
+  if (LOAD_REMAIN(s, p) < sizeof(uint32_t) + sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+  record_size = mrc_bin_to_uint32(p);
+  p += sizeof(uint32_t);
+  flen = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+
+  d = mrc_debug_info_alloc(s->c, irep);
+  d->pc_count = irep->ilen;
+  if (flen > 0) {
+    d->files = (mrc_irep_debug_info_file **)mrc_calloc(s->c, flen, sizeof(mrc_irep_debug_info_file *));
+    if (d->files == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  }
+  for (uint16_t i = 0; i < flen; i++) {
+    mrc_irep_debug_info_file *f;
+    uint16_t filename_idx;
+    size_t size;
+
+    if (LOAD_REMAIN(s, p) < sizeof(uint32_t) * 2 + sizeof(uint16_t) + sizeof(uint8_t)) return MRC_DUMP_READ_FAULT;
+    f = (mrc_irep_debug_info_file *)mrc_calloc(s->c, 1, sizeof(mrc_irep_debug_info_file));
+    if (f == NULL) return MRC_DUMP_GENERAL_FAILURE;
+    d->files[d->flen++] = f;
+    f->start_pos = mrc_bin_to_uint32(p);
+    p += sizeof(uint32_t);
+    filename_idx = mrc_bin_to_uint16(p);
+    p += sizeof(uint16_t);
+    if (filename_idx >= filenames_len) return MRC_DUMP_INVALID_IREP;
+    f->filename_sym = filenames[filename_idx];
+    f->line_entry_count = mrc_bin_to_uint32(p);
+    p += sizeof(uint32_t);
+    f->line_type = (mrc_debug_line_type)*p++;
+
+    switch (f->line_type) {
+    case mrc_debug_line_ary:
+      size = sizeof(uint16_t) * (size_t)f->line_entry_count;
+      if (LOAD_REMAIN(s, p) < size) return MRC_DUMP_READ_FAULT;
+      {
+        uint16_t *ary = (uint16_t *)mrc_malloc(s->c, size ? size : 1);
+        if (ary == NULL) return MRC_DUMP_GENERAL_FAILURE;
+        for (uint32_t l = 0; l < f->line_entry_count; l++) {
+          ary[l] = mrc_bin_to_uint16(p + l * sizeof(uint16_t));
+        }
+        f->lines.ary = ary;
+      }
+      break;
+
+    case mrc_debug_line_flat_map:
+      size = (sizeof(uint32_t) + sizeof(uint16_t)) * (size_t)f->line_entry_count;
+      if (LOAD_REMAIN(s, p) < size) return MRC_DUMP_READ_FAULT;
+      {
+        mrc_irep_debug_info_line *map = (mrc_irep_debug_info_line *)
+          mrc_malloc(s->c, sizeof(mrc_irep_debug_info_line) * (f->line_entry_count ? f->line_entry_count : 1));
+        if (map == NULL) return MRC_DUMP_GENERAL_FAILURE;
+        for (uint32_t l = 0; l < f->line_entry_count; l++) {
+          const uint8_t *e = p + l * (sizeof(uint32_t) + sizeof(uint16_t));
+          map[l].start_pos = mrc_bin_to_uint32(e);
+          map[l].line = mrc_bin_to_uint16(e + sizeof(uint32_t));
+        }
+        f->lines.flat_map = map;
+      }
+      break;
+
+    case mrc_debug_line_packed_map:
+      size = (size_t)f->line_entry_count;
+      if (LOAD_REMAIN(s, p) < size) return MRC_DUMP_READ_FAULT;
+      {
+        uint8_t *packed = (uint8_t *)mrc_malloc(s->c, size ? size : 1);
+        if (packed == NULL) return MRC_DUMP_GENERAL_FAILURE;
+        memcpy(packed, p, size);
+        f->lines.packed_map = packed;
+      }
+      break;
+
+    default:
+      return MRC_DUMP_INVALID_IREP;
+    }
+    p += size;
+  }
+  if ((size_t)(p - start) != record_size) return MRC_DUMP_INVALID_IREP;
+
+  for (int i = 0; i < irep->rlen; i++) {
+    int result = read_debug_record(s, &p, (mrc_irep *)irep->reps[i], filenames, filenames_len);
+    if (result != MRC_DUMP_OK) return result;
+  }
+  *pp = p;
+  return MRC_DUMP_OK;
+}
+
+static int
+read_section_debug(load_state *s, const uint8_t *p, mrc_irep *irep)
+{
+  mrc_sym *filenames = NULL;
+  uint16_t filenames_len;
+  int result;
+
+  p += sizeof(struct rite_section_debug_header);
+  if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+  filenames_len = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  result = read_sym_table(s, &p, filenames_len, FALSE, &filenames);
+  if (result != MRC_DUMP_OK) return result;
+  result = read_debug_record(s, &p, irep, filenames, filenames_len);
+  mrc_free(s->c, filenames);
+  return result;
+}
+
+static int
+read_lv_record(load_state *s, const uint8_t **pp, mrc_irep *irep, const mrc_sym *syms, uint32_t syms_len)
+{
+  const uint8_t *p = *pp;
+
+  if (irep->nlocals > 1) {
+    if (LOAD_REMAIN(s, p) < sizeof(uint16_t) * (irep->nlocals - 1)) return MRC_DUMP_READ_FAULT;
+    irep->lv = (mrc_sym *)mrc_calloc(s->c, irep->nlocals - 1, sizeof(mrc_sym));
+    if (irep->lv == NULL) return MRC_DUMP_GENERAL_FAILURE;
+    for (int i = 0; i + 1 < irep->nlocals; i++) {
+      uint16_t idx = mrc_bin_to_uint16(p);
+      p += sizeof(uint16_t);
+      if (idx == RITE_LV_NULL_MARK) continue;
+      if (idx >= syms_len) return MRC_DUMP_INVALID_IREP;
+      irep->lv[i] = syms[idx];
+    }
+  }
+  for (int i = 0; i < irep->rlen; i++) {
+    int result = read_lv_record(s, &p, (mrc_irep *)irep->reps[i], syms, syms_len);
+    if (result != MRC_DUMP_OK) return result;
+  }
+  *pp = p;
+  return MRC_DUMP_OK;
+}
+
+static int
+read_section_lv(load_state *s, const uint8_t *p, mrc_irep *irep)
+{
+  mrc_sym *syms = NULL;
+  uint32_t syms_len;
+  int result;
+
+  p += sizeof(struct rite_section_lv_header);
+  if (LOAD_REMAIN(s, p) < sizeof(uint32_t)) return MRC_DUMP_READ_FAULT;
+  syms_len = mrc_bin_to_uint32(p);
+  p += sizeof(uint32_t);
+  /* every entry takes at least its length field */
+  if (LOAD_REMAIN(s, p) / sizeof(uint16_t) < syms_len) return MRC_DUMP_READ_FAULT;
+  result = read_sym_table(s, &p, syms_len, FALSE, &syms);
+  if (result != MRC_DUMP_OK) return result;
+  result = read_lv_record(s, &p, irep, syms, syms_len);
+  mrc_free(s->c, syms);
+  return result;
+}
+
+static int
+read_section_strtab(load_state *s, const uint8_t *p)
+{
+  p += sizeof(struct rite_section_strtab_header);
+  if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+  s->strs_len = mrc_bin_to_uint16(p);
+  p += sizeof(uint16_t);
+  s->strs = (const uint8_t **)mrc_malloc(s->c, sizeof(const uint8_t *) * (s->strs_len ? s->strs_len : 1));
+  if (s->strs == NULL) return MRC_DUMP_GENERAL_FAILURE;
+  for (uint16_t i = 0; i < s->strs_len; i++) {
+    if (LOAD_REMAIN(s, p) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+    uint16_t len = mrc_bin_to_uint16(p);
+    if (LOAD_REMAIN(s, p) < sizeof(uint16_t) + (size_t)len + 1) return MRC_DUMP_READ_FAULT;
+    s->strs[i] = p;
+    p += sizeof(uint16_t) + len + 1;
+  }
+  return MRC_DUMP_OK;
+}
+
+static int
+read_binary(load_state *s, size_t size, mrc_irep **irepp)
+{
+  const uint8_t *p = s->image + sizeof(struct rite_binary_header);
+  int result;
+
+  for (;;) {
+    const struct rite_section_header *section = (const struct rite_section_header *)p;
+    size_t section_size;
+
+    if (LOAD_REMAIN(s, p) < sizeof(struct rite_section_header)) return MRC_DUMP_READ_FAULT;
+    section_size = mrc_bin_to_uint32(section->section_size);
+    if (section_size < sizeof(struct rite_section_header) || LOAD_REMAIN(s, p) < section_size) {
+      return MRC_DUMP_READ_FAULT;
+    }
+    /* keep every read of the section inside it */
+    s->end = p + section_size;
+
+    if (memcmp(section->section_ident, RITE_SECTION_IREP_IDENT, sizeof(section->section_ident)) == 0 ||
+        memcmp(section->section_ident, RITE_SECTION_IREP_ALIGNED_IDENT, sizeof(section->section_ident)) == 0) {
+      const uint8_t *rec = p + sizeof(struct rite_section_irep_header);
+
+      if (*irepp) return MRC_DUMP_INVALID_FILE_HEADER;
+      if (section_size < sizeof(struct rite_section_irep_header)) return MRC_DUMP_READ_FAULT;
+      s->aligned = memcmp(section->section_ident, RITE_SECTION_IREP_ALIGNED_IDENT, sizeof(section->section_ident)) == 0;
+      result = read_irep_record(s, &rec, irepp);
+    }
+    else if (memcmp(section->section_ident, RITE_SECTION_SYMTAB_IDENT, sizeof(section->section_ident)) == 0) {
+      const uint8_t *tab = p + sizeof(struct rite_section_symtab_header);
+
+      if (LOAD_REMAIN(s, tab) < sizeof(uint16_t)) return MRC_DUMP_READ_FAULT;
+      s->syms_len = mrc_bin_to_uint16(tab);
+      tab += sizeof(uint16_t);
+      result = read_sym_table(s, &tab, s->syms_len, TRUE, &s->syms);
+    }
+    else if (memcmp(section->section_ident, RITE_SECTION_STRTAB_IDENT, sizeof(section->section_ident)) == 0) {
+      result = read_section_strtab(s, p);
+    }
+    else if (memcmp(section->section_ident, RITE_SECTION_DEBUG_IDENT, sizeof(section->section_ident)) == 0) {
+      if (*irepp == NULL) return MRC_DUMP_INVALID_FILE_HEADER;
+      result = read_section_debug(s, p, *irepp);
+    }
+    else if (memcmp(section->section_ident, RITE_SECTION_LV_IDENT, sizeof(section->section_ident)) == 0) {
+      if (*irepp == NULL) return MRC_DUMP_INVALID_FILE_HEADER;
+      result = read_section_lv(s, p, *irepp);
+    }
+    else if (memcmp(section->section_ident, RITE_BINARY_EOF, sizeof(section->section_ident)) == 0) {
+      break;
+    }
+    else {
+      result = MRC_DUMP_OK;     /* unknown sections are skipped */
+    }
+    if (result != MRC_DUMP_OK) return result;
+    p += section_size;
+    s->end = s->image + size;
+  }
+  return *irepp ? MRC_DUMP_OK : MRC_DUMP_INVALID_IREP;
+}
+
+int
+mrc_read_irep(mrc_ccontext *c, const uint8_t *bin, size_t bin_size, mrc_irep **irepp)
+{
+  const struct rite_binary_header *header = (const struct rite_binary_header *)bin;
+  load_state s = { c, bin, NULL, FALSE, NULL, 0, NULL, 0 };
+  mrc_irep *irep = NULL;
+  size_t size;
+  int result;
+
+  if (irepp) *irepp = NULL;
+  if (c == NULL || bin == NULL || irepp == NULL || bin_size < sizeof(struct rite_binary_header)) {
+    return MRC_DUMP_INVALID_ARGUMENT;
+  }
+  if (memcmp(header->binary_ident, RITE_BINARY_IDENT, sizeof(header->binary_ident)) != 0 ||
+      memcmp(header->major_version, RITE_BINARY_MAJOR_VER, sizeof(header->major_version)) != 0 ||
+      memcmp(header->minor_version, RITE_BINARY_MINOR_VER_EXT, sizeof(header->minor_version)) > 0) {
+    return MRC_DUMP_INVALID_FILE_HEADER;
+  }
+  size = mrc_bin_to_uint32(header->binary_size);
+  if (size < sizeof(struct rite_binary_header) || bin_size < size) {
+    return MRC_DUMP_READ_FAULT;
+  }
+  s.end = bin + size;
+
+  result = read_binary(&s, size, &irep);
+  mrc_free(c, s.syms);
+  mrc_free(c, (void *)s.strs);
+  if (result != MRC_DUMP_OK) {
+    if (irep) mrc_irep_free(c, irep);
+    return result;
+  }
+  *irepp = irep;
+  return MRC_DUMP_OK;
+}
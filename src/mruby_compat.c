@@ -48,6 +48,10 @@ copy_context_to_mrc(mrc_ccontext *dst, const mrb_ccontext *src)
   dst->keep_lv = src->keep_lv;
   dst->no_optimize = src->no_optimize;
   dst->no_ext_ops = src->no_ext_ops;
+#if defined(MRC_SYM_PROC)
+  /* mrb_ccontext has no such flag; the build decides (see mrbgem.rake) */
+  dst->sym_proc = TRUE;
+#endif
   dst->upper = src->upper;
   if (src->filename) {
     mrc_ccontext_filename(dst, src->filename);
@@ -0,0 +1,139 @@
+#include "../include/mrc_position.h"
+
+/* lines scanned forward from the cursor before falling back to a binary search */
+#define POSITION_SCAN_MAX 8
+
+static size_t
+line_index(const pm_newline_list_t *list, size_t offset, size_t hint)
+{
+  size_t lo, hi;
+
+  if (list->size == 0) return 0;
+  if (hint < list->size && list->offsets[hint] <= offset) {
+    for (size_t i = hint; i < list->size && i < hint + POSITION_SCAN_MAX; i++) {
+      if (i + 1 == list->size || offset < list->offsets[i + 1]) return i;
+    }
+  }
+  /* last line starting at or before `offset`; offsets[0] is 0 */
+  lo = 0;
+  hi = list->size;
+  while (lo + 1 < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (list->offsets[mid] <= offset) lo = mid;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static size_t
+line_start(const pm_newline_list_t *list, size_t line)
+{
+  return list->size == 0 ? 0 : list->offsets[line];
+}
+
+#ifndef MRC_NO_STDIO
+static uint16_t
+file_index(const mrc_ccontext *c, size_t offset, uint16_t hint)
+{
+  const mrc_filename_table *t = c->filename_table;
+  uint16_t lo, hi;
+
+  if (hint < c->filename_table_length && t[hint].start <= offset &&
+      (hint + 1 == c->filename_table_length || offset < t[hint + 1].start)) {
+    return hint;
+  }
+  lo = 0;
+  hi = c->filename_table_length;
+  while (lo + 1 < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    if (t[mid].start <= offset) lo = mid;
+    else hi = mid;
+  }
+  return lo;
+}
+#endif
+
+static mrc_position_resolver*
+resolver(mrc_ccontext *c)
+{
+  mrc_position_resolver *r = c->positions;
+  const pm_newline_list_t *list = &c->p->newline_list;
+  const void *table = NULL;
+  uint16_t file_count = 0;
+
+#ifndef MRC_NO_STDIO
+  if (c->filename_table) {
+    table = c->filename_table;
+    file_count = c->filename_table_length;
+  }
+#endif
+  if (r == NULL) {
+    r = (mrc_position_resolver *)mrc_calloc(c, 1, sizeof(mrc_position_resolver));
+    if (r == NULL) return NULL;
+    c->positions = r;
+  }
+  else if (r->source == c->p->start && r->newline_count == list->size &&
+           r->table == table && r->file_count == file_count) {
+    return r;
+  }
+
+  mrc_free(c, r->file_lines);
+  r->file_lines = NULL;
+  r->source = c->p->start;
+  r->newline_count = list->size;
+  r->table = table;
+  r->file_count = file_count;
+  r->file = 0;
+  r->line = 0;
+#ifndef MRC_NO_STDIO
+  if (file_count > 0) {
+    r->file_lines = (size_t *)mrc_malloc(c, sizeof(size_t) * file_count);
+    if (r->file_lines == NULL) {
+      r->file_count = 0;
+      return NULL;
+    }
+    for (uint16_t i = 0; i < file_count; i++) {
+      r->file_lines[i] = line_index(list, c->filename_table[i].start, 0);
+    }
+  }
+#endif
+  return r;
+}
+
+mrc_bool
+mrc_position_resolve(mrc_ccontext *c, const uint8_t *pos, mrc_position *out)
+{
+  mrc_position_resolver *r;
+  const pm_newline_list_t *list = &c->p->newline_list;
+  size_t offset, file_start = 0, file_line = 0, start;
+
+  if (pos == NULL || pos < c->p->start || c->p->end < pos) return FALSE;
+  r = resolver(c);
+  if (r == NULL) return FALSE;
+
+  offset = (size_t)(pos - c->p->start);
+  out->file = 0;
+#ifndef MRC_NO_STDIO
+  if (r->file_count > 0) {
+    r->file = file_index(c, offset, r->file);
+    out->file = r->file;
+    file_start = c->filename_table[r->file].start;
+    file_line = r->file_lines[r->file];
+  }
+#endif
+  r->line = line_index(list, offset, r->line);
+  out->line = (uint32_t)(r->line - file_line + 1);
+  start = line_start(list, r->line);
+  if (start < file_start) start = file_start;
+  out->column = (uint32_t)(offset - start + 1);
+  return TRUE;
+}
+
+void
+mrc_position_resolver_free(mrc_ccontext *c)
+{
+  if (c->positions == NULL) return;
+  mrc_free(c, c->positions->file_lines);
+  mrc_free(c, c->positions);
+  c->positions = NULL;
+}
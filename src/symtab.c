@@ -0,0 +1,68 @@
+#include "../include/mrc_symtab.h"
+
+#define SYMTAB_HASH(sym) ((uint32_t)(sym) * 2654435761U)
+
+static uint32_t*
+symtab_slot(const mrc_symtab *t, mrc_sym sym)
+{
+  uint32_t mask = t->slot_capa - 1;
+  uint32_t i = SYMTAB_HASH(sym) & mask;
+
+  while (t->slots[i] != 0 && t->syms[t->slots[i] - 1] != sym) {
+    i = (i + 1) & mask;
+  }
+  return &t->slots[i];
+}
+
+int32_t
+mrc_symtab_find(const mrc_symtab *t, mrc_sym sym)
+{
+  if (t->slot_capa == 0) return -1;
+  uint32_t slot = *symtab_slot(t, sym);
+  return slot == 0 ? -1 : (int32_t)(slot - 1);
+}
+
+uint32_t
+mrc_symtab_add(mrc_ccontext *c, mrc_symtab *t, mrc_sym sym, mrc_bool *added)
+{
+  uint32_t *slot;
+
+  /* keep the load factor at or below one half */
+  if ((t->len + 1) * 2 > t->slot_capa) {
+    uint32_t old_capa = t->slot_capa;
+    uint32_t *old_slots = t->slots;
+
+    t->slot_capa = old_capa == 0 ? 16 : old_capa * 2;
+    t->slots = (uint32_t*)mrc_calloc(c, t->slot_capa, sizeof(uint32_t));
+    for (uint32_t i = 0; i < old_capa; i++) {
+      if (old_slots[i] != 0) {
+        *symtab_slot(t, t->syms[old_slots[i] - 1]) = old_slots[i];
+      }
+    }
+    mrc_free(c, old_slots);
+  }
+
+  slot = symtab_slot(t, sym);
+  if (*slot != 0) {             /* already registered */
+    if (added) *added = FALSE;
+    return *slot - 1;
+  }
+  if (t->len == t->capa) {
+    t->capa = t->capa == 0 ? 8 : t->capa * 2;
+    t->syms = (mrc_sym*)mrc_realloc(c, t->syms, sizeof(mrc_sym) * t->capa);
+  }
+  t->syms[t->len++] = sym;
+  *slot = t->len;
+  if (added) *added = TRUE;
+  return t->len - 1;
+}
+
+void
+mrc_symtab_free(mrc_ccontext *c, mrc_symtab *t)
+{
+  mrc_free(c, t->syms);
+  mrc_free(c, t->slots);
+  t->syms = NULL;
+  t->slots = NULL;
+  t->len = t->capa = t->slot_capa = 0;
+}
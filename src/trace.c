@@ -0,0 +1,119 @@
+#include <inttypes.h>
+#include <string.h>
+#include "../include/mrc_trace.h"
+#include "../include/mrc_json.h"
+
+static mrc_trace_event *
+trace_push(mrc_ccontext *c, char ph, const char *name, const char *file, uint32_t line)
+{
+  mrc_trace *t = c->trace;
+  mrc_trace_event *e;
+
+  if (t->len == t->capa) {
+    uint32_t capa = t->capa == 0 ? 64 : t->capa * 2;
+    mrc_trace_event *events = (mrc_trace_event *)mrc_realloc(c, t->events, sizeof(mrc_trace_event) * capa);
+    if (events == NULL) return NULL;
+    t->events = events;
+    t->capa = capa;
+  }
+  e = &t->events[t->len++];
+  e->name = name;
+  e->file = file;
+  e->line = line;
+  e->ph = ph;
+  e->ns = mrc_stats_clock();
+  mrc_stats_allocs(&e->allocs, &e->alloc_bytes);
+  e->ilen = 0;
+  e->plen = e->slen = 0;
+  return e;
+}
+
+void
+mrc_trace_begin(mrc_ccontext *c, const char *name, const char *file, uint32_t line)
+{
+  if (c->trace) trace_push(c, 'B', name, file, line);
+}
+
+void
+mrc_trace_end(mrc_ccontext *c, const char *name)
+{
+  if (c->trace) trace_push(c, 'E', name, NULL, 0);
+}
+
+void
+mrc_trace_end_irep(mrc_ccontext *c, const char *name, uint32_t ilen, uint16_t plen, uint16_t slen)
+{
+  mrc_trace_event *e;
+
+  if (c->trace == NULL) return;
+  e = trace_push(c, 'E', name, NULL, 0);
+  if (e == NULL) return;
+  e->ilen = ilen;
+  e->plen = plen;
+  e->slen = slen;
+}
+
+void
+mrc_trace_release(mrc_ccontext *c, mrc_trace *t)
+{
+  mrc_free(c, t->events);
+  t->events = NULL;
+  t->len = t->capa = 0;
+}
+
+#ifndef MRC_NO_STDIO
+/* the begin event that `end` closes, or NULL if it was dropped */
+static const mrc_trace_event *
+trace_begin_of(const mrc_trace *t, uint32_t end)
+{
+  uint32_t depth = 0;
+
+  for (uint32_t i = end; 0 < i--; ) {
+    const mrc_trace_event *e = &t->events[i];
+    if (e->ph == 'E') depth++;
+    else if (depth == 0) return strcmp(e->name, t->events[end].name) == 0 ? e : NULL;
+    else depth--;
+  }
+  return NULL;
+}
+
+void
+mrc_trace_dump_json(const mrc_trace *t, FILE *out)
+{
+  uint64_t origin = t->len > 0 ? t->events[0].ns : 0;
+
+  fputs("{\"traceEvents\":[", out);
+  for (uint32_t i = 0; i < t->len; i++) {
+    const mrc_trace_event *e = &t->events[i];
+    uint64_t ns = e->ns - origin;
+
+    fprintf(out, "%s\n{\"name\":", i == 0 ? "" : ",");
+    mrc_json_string(e->name, strlen(e->name), out);
+    fprintf(out, ",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03" PRIu64 ",\"pid\":1,\"tid\":1",
+            e->ph, ns / 1000, ns % 1000);
+    if (e->file) {
+      fputs(",\"args\":{\"file\":", out);
+      mrc_json_string(e->file, strlen(e->file), out);
+      fprintf(out, ",\"line\":%" PRIu32 "}", e->line);
+    }
+    else if (e->ph == 'E') {
+      const mrc_trace_event *b = trace_begin_of(t, i);
+      /* the counters stay zero without MRC_ALLOC_STATS */
+      mrc_bool allocs = b != NULL && 0 < e->allocs;
+
+      if (allocs || 0 < e->ilen) fputs(",\"args\":{", out);
+      if (allocs) {
+        fprintf(out, "\"allocs\":%" PRIu64 ",\"alloc_bytes\":%" PRIu64,
+                e->allocs - b->allocs, e->alloc_bytes - b->alloc_bytes);
+      }
+      if (0 < e->ilen) {
+        fprintf(out, "%s\"iseq\":%" PRIu32 ",\"pool\":%u,\"syms\":%u",
+                allocs ? "," : "", e->ilen, (unsigned)e->plen, (unsigned)e->slen);
+      }
+      if (allocs || 0 < e->ilen) fputc('}', out);
+    }
+    fputc('}', out);
+  }
+  fputs("\n]}\n", out);
+}
+#endif // MRC_NO_STDIO
@@ -0,0 +1,543 @@
+/*
+** mrc-bench - compile throughput and bytecode metrics of the Prism compiler
+**
+** Compiles every input file `-n` times and reports, as JSON, the best time
+** of each phase (parse, codegen, dump) with MB/s, ns/line, the
+** allocations made and the most bytes held at once. Allocations are counted
+** only when the compiler is built with MRC_ALLOC_STATS, as `MRC_BENCH=yes`
+** does.
+**
+** With --metrics it compiles every file once and reports what was
+** generated instead: instructions, registers, pool and symbol entries and
+** the size of each section of the dumped image, summed over the files.
+** --baseline compares them with a file written by --write-baseline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include "../../include/mrc_ccontext.h"
+#include "../../include/mrc_compile.h"
+#include "../../include/mrc_dump.h"
+#include "../../include/mrc_irep.h"
+#include "../../include/mrc_json.h"
+
+#define BENCH_ITERATIONS 5
+#define BENCH_LIST_LINE_MAX 4096
+
+typedef struct bench_phase {
+  uint64_t ns;                  /* best of the iterations */
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+  uint64_t peak_bytes;
+} bench_phase;
+
+typedef struct bench_result {
+  const char *file;
+  mrc_bool failed;
+  size_t bytes;
+  uint32_t lines;
+  bench_phase parse;
+  bench_phase codegen;
+  bench_phase dump;
+} bench_result;
+
+typedef struct bench_args {
+  const char **files;
+  int nfiles;
+  int capa;
+  int iterations;
+  mrc_bool no_optimize;
+  mrc_bool sym_proc;
+  uint8_t dump_flags;
+  const char *output;
+  mrc_bool metrics;
+  const char *baseline;
+  const char *write_baseline;
+} bench_args;
+
+/* the mrc_stats fields reported by --metrics, in report order */
+typedef struct bench_metric {
+  const char *name;
+  size_t offset;
+  size_t size;
+} bench_metric;
+
+#define METRIC(field) { #field, offsetof(mrc_stats, field), sizeof(((mrc_stats *)0)->field) }
+static const bench_metric metrics[] = {
+  METRIC(ireps),
+  METRIC(insns),
+  METRIC(ext_ops),
+  METRIC(nregs),
+  METRIC(pool_entries),
+  METRIC(syms),
+  METRIC(iseq_bytes),
+  METRIC(dump_bytes),
+  METRIC(irep_section_bytes),
+  METRIC(debug_section_bytes),
+  METRIC(lv_section_bytes),
+  METRIC(symtab_section_bytes),
+  METRIC(strtab_section_bytes),
+};
+#undef METRIC
+#define NMETRICS (sizeof(metrics) / sizeof(metrics[0]))
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [switches] files...\n"
+          "switches:\n"
+          "  -n N            compile every file N times, report the best (default %d)\n"
+          "  -l LIST         also read file names from LIST, one per line\n"
+          "  -g              dump with debug info\n"
+          "  --no-optimize   compile without the peephole and constant folding\n"
+          "  --sym-proc      compile `&:sym` to a lambda (c->sym_proc)\n"
+          "  -o FILE         write the .mrb of the only input file to FILE\n"
+          "  --metrics       report bytecode metrics instead of times\n"
+          "  --baseline FILE compare the metrics with FILE\n"
+          "  --write-baseline FILE\n"
+          "                  write the metrics to FILE\n",
+          name, BENCH_ITERATIONS);
+}
+
+static mrc_bool
+add_file(bench_args *args, const char *file)
+{
+  if (args->nfiles == args->capa) {
+    int capa = args->capa == 0 ? 64 : args->capa * 2;
+    const char **files = (const char **)realloc((void *)args->files, sizeof(char *) * capa);
+    if (files == NULL) return FALSE;
+    args->files = files;
+    args->capa = capa;
+  }
+  args->files[args->nfiles++] = file;
+  return TRUE;
+}
+
+static mrc_bool
+read_list(bench_args *args, const char *path)
+{
+  char line[BENCH_LIST_LINE_MAX];
+  FILE *fp = fopen(path, "r");
+
+  if (fp == NULL) {
+    fprintf(stderr, "mrc-bench: cannot open %s\n", path);
+    return FALSE;
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    size_t len = strcspn(line, "\r\n");
+    char *file;
+
+    if (len == 0 || line[0] == '#') continue;
+    file = (char *)malloc(len + 1);
+    if (file == NULL) break;
+    memcpy(file, line, len);
+    file[len] = '\0';
+    if (!add_file(args, file)) break;
+  }
+  fclose(fp);
+  return TRUE;
+}
+
+static mrc_bool
+parse_args(int argc, char **argv, bench_args *args)
+{
+  memset(args, 0, sizeof(*args));
+  args->iterations = BENCH_ITERATIONS;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+
+    if (strcmp(arg, "-n") == 0 && i + 1 < argc) {
+      args->iterations = atoi(argv[++i]);
+      if (args->iterations < 1) return FALSE;
+    }
+    else if (strcmp(arg, "-l") == 0 && i + 1 < argc) {
+      if (!read_list(args, argv[++i])) return FALSE;
+    }
+    else if (strcmp(arg, "-g") == 0) {
+      args->dump_flags |= MRC_DUMP_DEBUG_INFO;
+    }
+    else if (strcmp(arg, "--no-optimize") == 0) {
+      args->no_optimize = TRUE;
+    }
+    else if (strcmp(arg, "--sym-proc") == 0) {
+      args->sym_proc = TRUE;
+    }
+    else if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+      args->output = argv[++i];
+    }
+    else if (strcmp(arg, "--metrics") == 0) {
+      args->metrics = TRUE;
+    }
+    else if (strcmp(arg, "--baseline") == 0 && i + 1 < argc) {
+      args->metrics = TRUE;
+      args->baseline = argv[++i];
+    }
+    else if (strcmp(arg, "--write-baseline") == 0 && i + 1 < argc) {
+      args->metrics = TRUE;
+      args->write_baseline = argv[++i];
+    }
+    else if (arg[0] == '-') {
+      return FALSE;
+    }
+    else if (!add_file(args, arg)) {
+      return FALSE;
+    }
+  }
+  return args->nfiles > 0 && (args->output == NULL || args->nfiles == 1);
+}
+
+static uint8_t *
+read_source(const char *file, size_t *len)
+{
+  FILE *fp = fopen(file, "rb");
+  uint8_t *buf = NULL;
+  long size;
+
+  if (fp == NULL) return NULL;
+  if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+    buf = (uint8_t *)malloc((size_t)size + 1);
+    if (buf && fread(buf, 1, (size_t)size, fp) != (size_t)size) {
+      free(buf);
+      buf = NULL;
+    }
+    if (buf) {
+      buf[size] = '\0';
+      *len = (size_t)size;
+    }
+  }
+  fclose(fp);
+  return buf;
+}
+
+static void
+keep_best(bench_phase *best, uint64_t ns, uint64_t allocs, uint64_t alloc_bytes,
+          uint64_t peak_bytes, int iteration)
+{
+  if (iteration == 0 || ns < best->ns) best->ns = ns;
+  /* the same input allocates the same every time */
+  best->allocs = allocs;
+  best->alloc_bytes = alloc_bytes;
+  best->peak_bytes = peak_bytes;
+}
+
+static mrc_bool
+write_output(const char *path, const uint8_t *bin, size_t size)
+{
+  FILE *fp = fopen(path, "wb");
+  mrc_bool ok;
+
+  if (fp == NULL) {
+    fprintf(stderr, "mrc-bench: cannot write %s\n", path);
+    return FALSE;
+  }
+  ok = fwrite(bin, 1, size, fp) == size;
+  return fclose(fp) == 0 && ok;
+}
+
+/* compile `file` once, writing the image to args->output if given; FALSE if
+   it does not compile */
+static mrc_bool
+compile_once(mrb_state *mrb, const bench_args *args, const char *file,
+             const uint8_t *source, size_t len, mrc_stats *st)
+{
+  mrc_ccontext *c = mrc_ccontext_new(mrb);
+  const uint8_t *src = source;
+  mrc_irep *irep;
+  uint8_t *bin = NULL;
+  size_t bin_size = 0;
+  mrc_bool ok = FALSE;
+
+  if (c == NULL) return FALSE;
+  memset(st, 0, sizeof(*st));
+  c->stats = st;
+  c->no_optimize = args->no_optimize;
+  c->sym_proc = args->sym_proc;
+  mrc_ccontext_filename(c, file);
+  irep = mrc_load_string_cxt(c, &src, len);
+  if (irep) {
+    ok = mrc_dump_irep(c, irep, args->dump_flags, &bin, &bin_size) == MRC_DUMP_OK;
+    if (ok && args->output) ok = write_output(args->output, bin, bin_size);
+    mrc_free(c, bin);
+    mrc_irep_free(c, irep);
+  }
+  mrc_ccontext_free(c);
+  return ok;
+}
+
+static void
+bench_file(mrb_state *mrb, const bench_args *args, bench_result *r)
+{
+  size_t len = 0;
+  uint8_t *source = read_source(r->file, &len);
+  mrc_stats st;
+
+  if (source == NULL) {
+    r->failed = TRUE;
+    return;
+  }
+  r->bytes = len;
+  for (int i = 0; i < args->iterations; i++) {
+    if (!compile_once(mrb, args, r->file, source, len, &st)) {
+      r->failed = TRUE;
+      break;
+    }
+    r->lines = st.source_lines;
+    keep_best(&r->parse, st.parse_ns, st.parse_allocs, st.parse_alloc_bytes,
+              st.parse_peak_bytes, i);
+    keep_best(&r->codegen, st.codegen_ns, st.codegen_allocs, st.codegen_alloc_bytes,
+              st.codegen_peak_bytes, i);
+    keep_best(&r->dump, st.dump_ns, st.dump_allocs, st.dump_alloc_bytes,
+              st.dump_peak_bytes, i);
+  }
+  free(source);
+}
+
+static void
+add_phase(bench_phase *sum, const bench_phase *p)
+{
+  sum->ns += p->ns;
+  sum->allocs += p->allocs;
+  sum->alloc_bytes += p->alloc_bytes;
+  /* one file is compiled at a time */
+  if (p->peak_bytes > sum->peak_bytes) sum->peak_bytes = p->peak_bytes;
+}
+
+/* fixed key order and number format, so that reports diff cleanly */
+static void
+print_phase(const char *name, const bench_phase *p, size_t bytes, uint32_t lines, FILE *out)
+{
+  double mb_s = p->ns ? (double)bytes * 1000.0 / (double)p->ns : 0.0;
+  double ns_line = lines ? (double)p->ns / lines : 0.0;
+
+  fprintf(out, "\"%s\":{\"ns\":%" PRIu64 ",\"mb_s\":%.3f,\"ns_line\":%.3f,"
+          "\"allocs\":%" PRIu64 ",\"alloc_bytes\":%" PRIu64 ",\"peak_bytes\":%" PRIu64 "}",
+          name, p->ns, mb_s, ns_line, p->allocs, p->alloc_bytes, p->peak_bytes);
+}
+
+static void
+print_result(const bench_result *r, FILE *out)
+{
+  fprintf(out, "\"bytes\":%zu,\"lines\":%" PRIu32 ",", r->bytes, r->lines);
+  print_phase("parse", &r->parse, r->bytes, r->lines, out);
+  fputc(',', out);
+  print_phase("codegen", &r->codegen, r->bytes, r->lines, out);
+  fputc(',', out);
+  print_phase("dump", &r->dump, r->bytes, r->lines, out);
+}
+
+static int
+run_throughput(mrb_state *mrb, const bench_args *args)
+{
+  bench_result *results, total;
+  int failed = 0;
+
+  results = (bench_result *)calloc(args->nfiles, sizeof(bench_result));
+  if (results == NULL) return -1;
+
+  memset(&total, 0, sizeof(total));
+  for (int i = 0; i < args->nfiles; i++) {
+    bench_result *r = &results[i];
+
+    r->file = args->files[i];
+    bench_file(mrb, args, r);
+    if (r->failed) {
+      fprintf(stderr, "mrc-bench: %s: failed to compile\n", r->file);
+      failed++;
+      continue;
+    }
+    total.bytes += r->bytes;
+    total.lines += r->lines;
+    add_phase(&total.parse, &r->parse);
+    add_phase(&total.codegen, &r->codegen);
+    add_phase(&total.dump, &r->dump);
+  }
+
+  printf("{\"iterations\":%d,\"no_optimize\":%s,\"sym_proc\":%s,\"debug_info\":%s,\"failed\":%d,\n\"files\":[",
+         args->iterations, args->no_optimize ? "true" : "false", args->sym_proc ? "true" : "false",
+         (args->dump_flags & MRC_DUMP_DEBUG_INFO) ? "true" : "false", failed);
+  for (int i = 0, n = 0; i < args->nfiles; i++) {
+    if (results[i].failed) continue;
+    printf("%s\n{\"file\":", n++ == 0 ? "" : ",");
+    mrc_json_string(results[i].file, strlen(results[i].file), stdout);
+    putchar(',');
+    print_result(&results[i], stdout);
+    putchar('}');
+  }
+  printf("\n],\n\"total\":{");
+  print_result(&total, stdout);
+  printf("}}\n");
+
+  free(results);
+  return failed;
+}
+
+static uint64_t
+metric_value(const mrc_stats *st, const bench_metric *m)
+{
+  const char *p = (const char *)st + m->offset;
+
+  switch (m->size) {
+  case sizeof(uint64_t): return *(const uint64_t *)p;
+  case sizeof(uint32_t): return *(const uint32_t *)p;
+  default:               return *(const uint16_t *)p;
+  }
+}
+
+/* one flat JSON object; the settings are kept so that a baseline is only
+   compared with metrics taken the same way */
+static void
+print_metrics(const uint64_t *values, const bench_args *args, int files, FILE *out)
+{
+  fprintf(out, "{\n\"files\":%d,\n\"no_optimize\":%d,\n\"sym_proc\":%d,\n\"debug_info\":%d", files,
+          args->no_optimize ? 1 : 0, args->sym_proc ? 1 : 0,
+          (args->dump_flags & MRC_DUMP_DEBUG_INFO) ? 1 : 0);
+  for (size_t i = 0; i < NMETRICS; i++) {
+    fprintf(out, ",\n\"%s\":%" PRIu64, metrics[i].name, values[i]);
+  }
+  fputs("\n}\n", out);
+}
+
+static char *
+read_text(const char *path)
+{
+  size_t len;
+  return (char *)read_source(path, &len);
+}
+
+/* the number after "name": in a flat JSON object; FALSE if the key is
+   missing or null */
+static mrc_bool
+baseline_value(const char *json, const char *name, uint64_t *value)
+{
+  size_t len = strlen(name);
+  const char *p = json;
+  char *end;
+
+  while ((p = strchr(p, '"')) != NULL) {
+    p++;
+    if (strncmp(p, name, len) == 0 && p[len] == '"') {
+      p += len + 1;
+      p += strspn(p, " \t\r\n");
+      if (*p++ != ':') return FALSE;
+      p += strspn(p, " \t\r\n");
+      *value = strtoull(p, &end, 10);
+      return end != p;
+    }
+    p = strchr(p, '"');
+    if (p == NULL) break;
+    p++;
+  }
+  return FALSE;
+}
+
+static int
+compare_baseline(const uint64_t *values, const bench_args *args, int files)
+{
+  char *json = read_text(args->baseline);
+  uint64_t base;
+
+  if (json == NULL) {
+    fprintf(stderr, "mrc-bench: cannot read %s\n", args->baseline);
+    return -1;
+  }
+  if ((baseline_value(json, "no_optimize", &base) && base != (args->no_optimize ? 1 : 0)) ||
+      (baseline_value(json, "sym_proc", &base) && base != (args->sym_proc ? 1 : 0)) ||
+      (baseline_value(json, "debug_info", &base) &&
+       base != ((args->dump_flags & MRC_DUMP_DEBUG_INFO) ? 1 : 0))) {
+    fprintf(stderr, "mrc-bench: %s was written with other --no-optimize/--sym-proc/-g settings\n",
+            args->baseline);
+    free(json);
+    return -1;
+  }
+  if (baseline_value(json, "files", &base) && base != (uint64_t)files) {
+    fprintf(stderr, "mrc-bench: %s has %" PRIu64 " files, this run %d\n", args->baseline, base, files);
+  }
+
+  printf("%-22s %14s %14s %14s\n", "metric", "baseline", "current", "change");
+  for (size_t i = 0; i < NMETRICS; i++) {
+    int64_t delta;
+
+    if (!baseline_value(json, metrics[i].name, &base)) {
+      printf("%-22s %14s %14" PRIu64 " %14s\n", metrics[i].name, "-", values[i], "-");
+      continue;
+    }
+    delta = (int64_t)(values[i] - base);
+    printf("%-22s %14" PRIu64 " %14" PRIu64 " %+14" PRId64, metrics[i].name, base, values[i], delta);
+    if (base && delta) printf(" (%+.2f%%)", (double)delta * 100.0 / (double)base);
+    putchar('\n');
+  }
+  free(json);
+  return 0;
+}
+
+static int
+run_metrics(mrb_state *mrb, const bench_args *args)
+{
+  uint64_t values[NMETRICS] = {0};
+  int files = 0, failed = 0;
+
+  for (int i = 0; i < args->nfiles; i++) {
+    size_t len = 0;
+    uint8_t *source = read_source(args->files[i], &len);
+    mrc_stats st;
+
+    if (source == NULL || !compile_once(mrb, args, args->files[i], source, len, &st)) {
+      fprintf(stderr, "mrc-bench: %s: failed to compile\n", args->files[i]);
+      free(source);
+      failed++;
+      continue;
+    }
+    free(source);
+    for (size_t m = 0; m < NMETRICS; m++) {
+      values[m] += metric_value(&st, &metrics[m]);
+    }
+    files++;
+  }
+
+  if (args->write_baseline) {
+    FILE *fp = fopen(args->write_baseline, "w");
+
+    if (fp == NULL) {
+      fprintf(stderr, "mrc-bench: cannot write %s\n", args->write_baseline);
+      return -1;
+    }
+    print_metrics(values, args, files, fp);
+    fclose(fp);
+  }
+  if (args->baseline) {
+    if (compare_baseline(values, args, files) < 0) return -1;
+  }
+  else if (!args->write_baseline) {
+    print_metrics(values, args, files, stdout);
+  }
+  return failed;
+}
+
+int
+main(int argc, char **argv)
+{
+  bench_args args;
+  mrb_state *mrb = NULL;
+  int failed;
+
+  if (!parse_args(argc, argv, &args)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+#if defined(MRC_TARGET_MRUBY)
+  mrb = mrb_open();
+  if (mrb == NULL) {
+    fputs("mrc-bench: cannot open mrb_state\n", stderr);
+    return EXIT_FAILURE;
+  }
+#endif
+  failed = args.metrics ? run_metrics(mrb, &args) : run_throughput(mrb, &args);
+#if defined(MRC_TARGET_MRUBY)
+  mrb_close(mrb);
+#endif
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}